@@ -16,6 +16,7 @@ class aabb
 
     aabb(const interval &x, const interval &y, const interval &z) : x(x), y(y), z(z)
     {
+        pad_to_minimums();
     }
 
     aabb(const point3 &a, const point3 &b)
@@ -23,6 +24,9 @@ class aabb
         x = a[0] < b[0] ? interval(a[0], b[0]) : interval(b[0], a[0]);
         y = a[1] < b[1] ? interval(a[1], b[1]) : interval(b[1], a[1]);
         z = a[2] < b[2] ? interval(a[2], b[2]) : interval(b[2], a[2]);
+
+        // 防止quad等平面物体的bbox厚度为0，导致光线永远无法与bbox相交
+        pad_to_minimums();
     }
 
     aabb(const aabb &a, const aabb &b)
@@ -65,10 +69,10 @@ class aabb
         for (int axis = 0; axis < 3; ++axis)
         {
             const interval &ax = axis_interal(axis);
-            const double d_inv = 1 / dir[axis];
+            const real d_inv = 1 / dir[axis];
 
-            double t0 = (ax.min - ray_orig[axis]) * d_inv;
-            double t1 = (ax.max - ray_orig[axis]) * d_inv;
+            real t0 = (ax.min - ray_orig[axis]) * d_inv;
+            real t1 = (ax.max - ray_orig[axis]) * d_inv;
 
             if (t0 < t1)
             {
@@ -99,9 +103,9 @@ class aabb
             return y.size() > z.size() ? 1 : 2;
     }
 
-    int surface_area() const
+    real surface_area() const
     {
-        return 2 * x.size() * y.size() + x.size() * z.size() + y.size() * z.size();
+        return 2 * (x.size() * y.size() + x.size() * z.size() + y.size() * z.size());
     }
 
     static const aabb empty, universe;
@@ -109,7 +113,7 @@ class aabb
   private:
     void pad_to_minimums()
     {
-        double delta = 0.0001;
+        real delta = 0.0001;
 
         if (x.size() < delta)
         {
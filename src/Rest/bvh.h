@@ -1,20 +1,134 @@
 #ifndef BVH_H
 #define BVH_H
 
-#include "NextWeek/aabb.h"
-#include "NextWeek/interval.h"
+#include "aabb.h"
+#include "interval.h"
 #include "global.h"
 #include "hittable.h"
 #include "hittable_list.h"
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <ctime>
+#include <exception>
 #include <iterator>
+#include <thread>
 #include <vector>
 
+class flat_bvh;
+class bvh4;
+
+/**
+ * @brief 构建BVH时使用的物体信息，预先计算bbox和质心，整个构建过程共用一份数组
+ */
+struct bvh_primitive
+{
+    shared_ptr<hittable> object;
+    aabb bbox;
+    point3 centroid;
+};
+
+/**
+ * @brief 在三个轴上按质心分桶计算SAH代价，选择代价最小的划分并原地划分图元
+ * Primitive需要有bbox和centroid成员，bvh_node和三角形网格的BVH共用该函数
+ *
+ * @param bbox 区间内所有图元的bbox
+ * @param centroid_bounds 区间内所有图元质心的bbox
+ * @param split_axis 找到划分时设置为划分所用的轴
+ * @return 右子树第一个图元的下标
+ */
+template <class Primitive>
+size_t binned_sah_split(std::vector<Primitive> &primitives, size_t start, size_t end, const aabb &bbox,
+                        const aabb &centroid_bounds, int &split_axis)
+{
+    constexpr int bin_num = 16; // 每个轴上的桶数
+    auto bin_index = [](double centroid, double min, double scale) {
+        int b = int((centroid - min) * scale);
+        return b < bin_num ? b : bin_num - 1;
+    };
+
+    double cost_traversal = 0.125, cost_intersect = 1;
+    double total_area = bbox.surface_area();
+
+    int best_axis = -1, best_bin = -1;
+    double min_cost = std::numeric_limits<double>::infinity();
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const interval &extent = centroid_bounds.axis_interal(axis);
+        // 质心在该轴上重合，无法划分
+        if (extent.size() <= 0)
+            continue;
+
+        aabb bin_bbox[bin_num];
+        size_t bin_count[bin_num] = {};
+        double scale = bin_num / extent.size();
+
+        for (size_t index = start; index < end; ++index)
+        {
+            int b = bin_index(primitives[index].centroid[axis], extent.min, scale);
+            ++bin_count[b];
+            bin_bbox[b] = aabb(bin_bbox[b], primitives[index].bbox);
+        }
+
+        // 从右向左扫描，记录每个划分位置右侧的面积和数量
+        double right_cost[bin_num];
+        aabb right_bbox = aabb::empty;
+        size_t right_count = 0;
+        for (int b = bin_num - 1; b > 0; --b)
+        {
+            right_bbox = aabb(right_bbox, bin_bbox[b]);
+            right_count += bin_count[b];
+            right_cost[b] = right_count == 0 ? 0 : right_bbox.surface_area() * right_count;
+        }
+
+        // 从左向右扫描，在桶b左侧划分
+        aabb left_bbox = aabb::empty;
+        size_t left_count = 0;
+        for (int b = 1; b < bin_num; ++b)
+        {
+            left_bbox = aabb(left_bbox, bin_bbox[b - 1]);
+            left_count += bin_count[b - 1];
+            if (left_count == 0 || left_count == end - start)
+                continue;
+
+            double cost = cost_traversal +
+                          cost_intersect * (left_bbox.surface_area() * left_count + right_cost[b]) / total_area;
+            if (cost < min_cost)
+            {
+                min_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    size_t mid = start + (end - start) / 2;
+
+    if (best_axis < 0)
+    {
+        // 所有质心重合，直接从中间划分
+        return mid;
+    }
+
+    split_axis = best_axis;
+    const interval &extent = centroid_bounds.axis_interal(best_axis);
+    double scale = bin_num / extent.size();
+    auto split = std::partition(primitives.begin() + start, primitives.begin() + end, [&](const Primitive &p) {
+        return bin_index(p.centroid[best_axis], extent.min, scale) < best_bin;
+    });
+    mid = split - primitives.begin();
+
+    return mid;
+}
+
 class bvh_node : public hittable
 {
+    friend class flat_bvh;
+    friend class bvh4;
+
   public:
     bvh_node(hittable_list list) : bvh_node(list.objects, 0, list.objects.size())
     {
@@ -24,56 +138,289 @@ class bvh_node : public hittable
 
     bvh_node(std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end)
     {
-        // 排序，构造二叉树
+        // 只在根节点计算一次所有物体的bbox和质心，子树构建时原地划分该数组
+        std::vector<bvh_primitive> primitives;
+        primitives.reserve(end - start);
+        for (size_t index = start; index < end; ++index)
+        {
+            aabb box = objects[index]->bounding_box();
+            point3 centroid(0.5 * (box.x.min + box.x.max), 0.5 * (box.y.min + box.y.max),
+                            0.5 * (box.z.min + box.z.max));
+            primitives.push_back({objects[index], box, centroid});
+        }
+
+        // 顶层若干层的子树交给新线程构建，线程数与硬件并行度相当
+        int spawn_depth = 0;
+        for (unsigned int threads = std::thread::hardware_concurrency(); threads > 1; threads = (threads + 1) / 2)
+            ++spawn_depth;
+
+        build(primitives, 0, primitives.size(), spawn_depth);
+    }
+
+    bvh_node(std::vector<bvh_primitive> &primitives, size_t start, size_t end, int spawn_depth = 0)
+    {
+        build(primitives, start, end, spawn_depth);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        if (!bbox.hit(r, ray_t))
+            return false;
+        bool hit_left = left->hit(r, ray_t, rec);
+        // 在多个相交物体中，寻找更近的交点
+        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+
+        return hit_left || hit_right;
+    }
+
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        if (!bbox.hit(r, ray_t))
+            return false;
+        return left->occluded(r, ray_t) || right->occluded(r, ray_t);
+    }
+
+    aabb bounding_box() const override
+    {
+        return bbox;
+    }
 
-        // int axis = random_int(0, 2);
-        //
-        // auto comparator = (axis == 0) ? box_x_compare : ((axis == 1) ? box_y_compare : box_z_compare);
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        left->collect_lights(lights);
+        if (right != left)
+            right->collect_lights(lights);
+    }
+
+  private:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb bbox;
+    int split_axis = 0; // 切分所用的轴，展开为线性BVH时用于决定遍历顺序
+
+    static constexpr size_t parallel_threshold = 256; // 子树物体数不少于该值时才并行构建
+
+    void build(std::vector<bvh_primitive> &primitives, size_t start, size_t end, int spawn_depth)
+    {
         bbox = aabb::empty;
+        aabb centroid_bounds = aabb::empty;
 
         for (size_t index = start; index < end; ++index)
         {
-            bbox = aabb(bbox, objects[index]->bounding_box());
+            bbox = aabb(bbox, primitives[index].bbox);
+            centroid_bounds = aabb(centroid_bounds, aabb(primitives[index].centroid, primitives[index].centroid));
         }
 
-        // 选取最长的轴进行切分
-        int axis = bbox.longest_axis();
-
-        auto comparator = (axis == 0) ? box_x_compare : ((axis == 1) ? box_y_compare : box_z_compare);
+        split_axis = centroid_bounds.longest_axis();
 
         size_t object_span = end - start;
 
         if (object_span == 1)
         {
-            left = right = objects[start];
+            left = right = primitives[start].object;
+            return;
         }
-        else if (object_span == 2)
+        if (object_span == 2)
         {
-            left = objects[start];
-            right = objects[start + 1];
+            // 保证左孩子在切分轴上靠前，遍历时才能正确地先访问近处的孩子
+            bool swap = primitives[start + 1].centroid[split_axis] < primitives[start].centroid[split_axis];
+            left = primitives[swap ? start + 1 : start].object;
+            right = primitives[swap ? start : start + 1].object;
+            return;
+        }
+
+        size_t mid = binned_sah_split(primitives, start, end, bbox, centroid_bounds, split_axis);
+
+        // 左右子树只访问各自的区间，可以并行划分；子树太小时创建线程得不偿失
+        if (spawn_depth > 0 && object_span >= parallel_threshold)
+        {
+            // 任何一侧抛出异常（如bad_alloc）时都要先等待线程结束，否则销毁未join的线程会调用std::terminate
+            std::exception_ptr right_error;
+            std::thread right_builder([&, mid, end]() {
+                try
+                {
+                    right = make_shared<bvh_node>(primitives, mid, end, spawn_depth - 1);
+                }
+                catch (...)
+                {
+                    right_error = std::current_exception();
+                }
+            });
+            try
+            {
+                left = make_shared<bvh_node>(primitives, start, mid, spawn_depth - 1);
+            }
+            catch (...)
+            {
+                right_builder.join();
+                throw;
+            }
+            right_builder.join();
+            if (right_error)
+                std::rethrow_exception(right_error);
         }
         else
         {
-            std::sort(std::begin(objects) + start, std::begin(objects) + end, comparator);
-
-            // int mid = object_span / 2;
-            int mid = SAHSplit(objects, start, end);
-            left = make_shared<bvh_node>(objects, start, start + mid);
-            right = make_shared<bvh_node>(objects, start + mid, end);
+            left = make_shared<bvh_node>(primitives, start, mid);
+            right = make_shared<bvh_node>(primitives, mid, end);
         }
+    }
+};
+
+/**
+ * @brief 线性BVH中的节点，按深度优先顺序存储在连续数组中，每个节点32字节
+ * 内部节点的左孩子紧跟在其后，offset记录右孩子的下标；叶子节点的offset记录第一个物体的下标
+ */
+struct alignas(32) linear_bvh_node
+{
+    float bounds_min[3];     // bbox最小点，向下取整到float
+    float bounds_max[3];     // bbox最大点，向上取整到float
+    int32_t offset;          // 内部节点：右孩子下标；叶子节点：物体起始下标
+    uint16_t primitive_num;  // 叶子中物体数量，为0表示内部节点
+    uint8_t axis;            // 内部节点的切分轴
+    uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should be 32 bytes");
+
+/**
+ * @brief 将构建完成的bvh_node展开为连续数组，使用栈迭代遍历，减少虚函数调用与缓存缺失
+ */
+class flat_bvh : public hittable
+{
+  public:
+    flat_bvh(hittable_list list) : flat_bvh(bvh_node(list))
+    {
+    }
 
-        // bbox = aabb(left->bounding_box(), right->bounding_box());
+    flat_bvh(const bvh_node &root) : bbox(root.bounding_box())
+    {
+        flatten(root);
+        nodes.shrink_to_fit();
+        primitives.shrink_to_fit();
     }
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
-        if (!bbox.hit(r, ray_t))
-            return false;
-        bool hit_left = left->hit(r, ray_t, rec);
-        // 在多个相交物体中，寻找更近的交点
-        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+        const point3 &orig = r.origin();
+        const vec3 &dir = r.direction();
+        // 每条光线只计算一次方向的倒数
+        const double inv_dir[3] = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+        const bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
 
-        return hit_left || hit_right;
+        bool hit_anything = false;
+        // 待访问节点栈，树过深时退化为堆上分配
+        int local_stack[max_stack_depth];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (tree_depth > max_stack_depth)
+        {
+            heap_stack.resize(tree_depth);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        int current = 0;
+
+        while (true)
+        {
+            const linear_bvh_node &node = nodes[current];
+            if (hit_bounds(node, orig, inv_dir, dir_is_neg, ray_t))
+            {
+                if (node.primitive_num > 0)
+                {
+                    for (int i = 0; i < node.primitive_num; ++i)
+                    {
+                        // 找到更近的交点后缩小光线区间
+                        if (primitives[node.offset + i]->hit(r, ray_t, rec))
+                        {
+                            hit_anything = true;
+                            ray_t.max = rec.t;
+                        }
+                    }
+                    if (stack_size == 0)
+                        break;
+                    current = to_visit[--stack_size];
+                }
+                else if (dir_is_neg[node.axis])
+                {
+                    // 光线沿负方向前进，先访问右孩子
+                    to_visit[stack_size++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    to_visit[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+            else
+            {
+                if (stack_size == 0)
+                    break;
+                current = to_visit[--stack_size];
+            }
+        }
+
+        return hit_anything;
+    }
+
+    /**
+     * @brief 与hit的遍历顺序相同，找到任意交点后立即返回
+     */
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        const point3 &orig = r.origin();
+        const vec3 &dir = r.direction();
+        const double inv_dir[3] = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+        const bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+        int local_stack[max_stack_depth];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (tree_depth > max_stack_depth)
+        {
+            heap_stack.resize(tree_depth);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        int current = 0;
+
+        while (true)
+        {
+            const linear_bvh_node &node = nodes[current];
+            if (hit_bounds(node, orig, inv_dir, dir_is_neg, ray_t))
+            {
+                if (node.primitive_num > 0)
+                {
+                    for (int i = 0; i < node.primitive_num; ++i)
+                    {
+                        if (primitives[node.offset + i]->occluded(r, ray_t))
+                            return true;
+                    }
+                    if (stack_size == 0)
+                        break;
+                    current = to_visit[--stack_size];
+                }
+                else if (dir_is_neg[node.axis])
+                {
+                    to_visit[stack_size++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    to_visit[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+            else
+            {
+                if (stack_size == 0)
+                    break;
+                current = to_visit[--stack_size];
+            }
+        }
+
+        return false;
     }
 
     aabb bounding_box() const override
@@ -81,73 +428,116 @@ class bvh_node : public hittable
         return bbox;
     }
 
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        for (const auto &primitive : primitives)
+            primitive->collect_lights(lights);
+    }
+
+    size_t node_count() const
+    {
+        return nodes.size();
+    }
+
   private:
-    shared_ptr<hittable> left;
-    shared_ptr<hittable> right;
+    static constexpr int max_stack_depth = 64;
+
+    std::vector<linear_bvh_node> nodes;
+    std::vector<shared_ptr<hittable>> primitives;
     aabb bbox;
+    int tree_depth = 0;
 
-    static bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index)
+    static float round_down(double x)
     {
-        auto a_axis_interval = a->bounding_box().axis_interal(axis_index);
-        auto b_axis_interval = b->bounding_box().axis_interal(axis_index);
-        return a_axis_interval.min < b_axis_interval.min;
+        float f = static_cast<float>(x);
+        return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
     }
 
-    static bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
+    static float round_up(double x)
     {
-        return box_compare(a, b, 0);
+        float f = static_cast<float>(x);
+        return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
     }
 
-    static bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
+    static bool hit_bounds(const linear_bvh_node &node, const point3 &orig, const double inv_dir[3],
+                           const bool dir_is_neg[3], const interval &ray_t)
     {
-        return box_compare(a, b, 1);
+        double t_min = ray_t.min, t_max = ray_t.max;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            // 根据方向符号直接选出近平面和远平面，避免比较
+            double near_plane = dir_is_neg[axis] ? node.bounds_max[axis] : node.bounds_min[axis];
+            double far_plane = dir_is_neg[axis] ? node.bounds_min[axis] : node.bounds_max[axis];
+            double t0 = (near_plane - orig[axis]) * inv_dir[axis];
+            double t1 = (far_plane - orig[axis]) * inv_dir[axis];
+            if (t0 > t_min)
+                t_min = t0;
+            if (t1 < t_max)
+                t_max = t1;
+            if (t_min > t_max)
+                return false;
+        }
+        return true;
     }
 
-    static bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
+    int push_node(const aabb &box)
     {
-        return box_compare(a, b, 2);
+        linear_bvh_node node;
+        const interval *axes[3] = {&box.x, &box.y, &box.z};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.bounds_min[axis] = round_down(axes[axis]->min);
+            node.bounds_max[axis] = round_up(axes[axis]->max);
+        }
+        node.offset = 0;
+        node.primitive_num = 0;
+        node.axis = 0;
+        node.pad = 0;
+        nodes.push_back(node);
+        return static_cast<int>(nodes.size() - 1);
     }
 
-    int SAHSplit(const std::vector<shared_ptr<hittable>> &objects, int begin, int end)
+    void push_leaf(const shared_ptr<hittable> &object)
     {
-        double cost_traversal = 0.125, cost_intersect = 1;
-        size_t n = end - begin;
-        // 预先设定好划分的区域数，区域数等于n时说明每种划分都考虑
-        // int area_num = n > 20 ? 20 : n;
-        int area_num = n;
-        if (n == 0)
-            return -1; // 边界条件检查
+        int index = push_node(object->bounding_box());
+        nodes[index].offset = static_cast<int32_t>(primitives.size());
+        nodes[index].primitive_num = 1;
+        primitives.push_back(object);
+    }
 
-        // 计算object的前缀和以及后缀和，后续选择分割点时只需查询即可
-        std::vector<aabb> pre(n + 1, aabb::empty), suff(n + 1, aabb::empty);
-        for (int i = begin; i < end; ++i)
-        {
-            // 当前物体在列表中的相对位置
-            int index = i - begin;
-            pre[index + 1] = aabb(pre[index], objects[i]->bounding_box());
-            // 注意如何合并bbox
-            suff[n - 1 - index] = aabb(suff[n - index], objects[n - 1 - index + begin]->bounding_box()); // 修正后缀计算
-        }
+    void flatten_child(const shared_ptr<hittable> &child, int depth)
+    {
+        // 子节点仍是bvh_node则递归展开，否则视为叶子中的物体
+        if (auto child_node = std::dynamic_pointer_cast<bvh_node>(child))
+            flatten(*child_node, depth);
+        else
+            push_leaf(child);
+    }
 
-        assert(pre[n].surface_area() == suff[0].surface_area());
+    void flatten(const bvh_node &node, int depth = 1)
+    {
+        tree_depth = std::max(tree_depth, depth);
 
-        int split_num = -1;
-        double min_cost = std::numeric_limits<double>::infinity();
-        double total_area = pre[n].surface_area();
+        bool left_leaf = !std::dynamic_pointer_cast<bvh_node>(node.left);
+        bool right_leaf = !std::dynamic_pointer_cast<bvh_node>(node.right);
 
-        for (int i = 0; i < area_num; ++i)
+        // 两个孩子都是物体时合并为一个叶子
+        if (left_leaf && right_leaf)
         {
-            int index = n * (i + 1) / area_num; // 避免在第0个位置或n位置分割
-            double cost = cost_traversal + pre[index].surface_area() / total_area * cost_intersect * (index) +
-                          suff[index].surface_area() / total_area * cost_intersect * (n - index);
-            if (cost < min_cost)
-            {
-                min_cost = cost;
-                split_num = index;
-            }
+            int index = push_node(node.bbox);
+            nodes[index].offset = static_cast<int32_t>(primitives.size());
+            primitives.push_back(node.left);
+            if (node.right != node.left)
+                primitives.push_back(node.right);
+            nodes[index].primitive_num = static_cast<uint16_t>(primitives.size() - nodes[index].offset);
+            return;
         }
 
-        return split_num;
+        int index = push_node(node.bbox);
+        nodes[index].axis = static_cast<uint8_t>(node.split_axis);
+        flatten_child(node.left, depth + 1);
+        nodes[index].offset = static_cast<int32_t>(nodes.size());
+        flatten_child(node.right, depth + 1);
     }
 };
 
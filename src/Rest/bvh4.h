@@ -0,0 +1,554 @@
+#ifndef BVH4_H
+#define BVH4_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "global.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "interval.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief 四叉BVH节点，四个孩子的bbox按SoA方式存储，一次SIMD运算即可与四个bbox求交
+ * 孩子的count为0时child是内部节点下标（为-1表示空位），否则child是叶子中第一个物体的下标
+ */
+struct alignas(64) bvh4_node
+{
+    float bounds[6][4]; // 依次为min x, y, z, max x, y, z，每行是四个孩子的值
+    int32_t child[4];
+    uint8_t count[4];
+};
+
+/**
+ * @brief 由bvh_node折叠而成的四叉BVH，每个节点的四个孩子使用SSE同时测试
+ */
+class bvh4 : public hittable
+{
+  public:
+    bvh4(hittable_list list) : bvh4(bvh_node(list))
+    {
+    }
+
+    bvh4(const bvh_node &root) : bbox(root.bounding_box())
+    {
+        build(root, 1);
+        nodes.shrink_to_fit();
+        primitives.shrink_to_fit();
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        // 每条光线只计算一次方向的倒数和符号
+        ray_data data(r);
+
+        bool hit_anything = false;
+        // 待访问节点栈，每层最多压入三个节点，树过深时退化为堆上分配
+        int local_stack[max_stack_size];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (3 * tree_depth + 1 > max_stack_size)
+        {
+            heap_stack.resize(3 * tree_depth + 1);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        to_visit[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const bvh4_node &node = nodes[to_visit[--stack_size]];
+
+            float t_near[4];
+            int mask = intersect(node, data, ray_t, t_near);
+            if (mask == 0)
+                continue;
+
+            // 按进入距离从近到远排列相交的孩子
+            int order[4];
+            int hit_num = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                if (!(mask & (1 << c)))
+                    continue;
+                int k = hit_num++;
+                while (k > 0 && t_near[order[k - 1]] > t_near[c])
+                {
+                    order[k] = order[k - 1];
+                    --k;
+                }
+                order[k] = c;
+            }
+
+            // 叶子直接求交，内部节点从远到近压栈，保证先弹出近处的节点
+            for (int k = 0; k < hit_num; ++k)
+            {
+                int c = order[k];
+                if (node.count[c] == 0)
+                    continue;
+                for (int i = 0; i < node.count[c]; ++i)
+                {
+                    if (primitives[node.child[c] + i]->hit(r, ray_t, rec))
+                    {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+            }
+            for (int k = hit_num - 1; k >= 0; --k)
+            {
+                int c = order[k];
+                if (node.count[c] == 0)
+                    to_visit[stack_size++] = node.child[c];
+            }
+        }
+
+        return hit_anything;
+    }
+
+    /**
+     * @brief 找到任意交点后立即返回，不需要按距离排序孩子，叶子在压栈前先求交
+     */
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        ray_data data(r);
+
+        int local_stack[max_stack_size];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (3 * tree_depth + 1 > max_stack_size)
+        {
+            heap_stack.resize(3 * tree_depth + 1);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        to_visit[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const bvh4_node &node = nodes[to_visit[--stack_size]];
+
+            float t_near[4];
+            int mask = intersect(node, data, ray_t, t_near);
+            for (int c = 0; c < 4; ++c)
+            {
+                if (!(mask & (1 << c)) || node.count[c] == 0)
+                    continue;
+                for (int i = 0; i < node.count[c]; ++i)
+                {
+                    if (primitives[node.child[c] + i]->occluded(r, ray_t))
+                        return true;
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                if ((mask & (1 << c)) && node.count[c] == 0)
+                    to_visit[stack_size++] = node.child[c];
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief 成组遍历：每个节点只读取一次，对组内仍然活跃的光线逐条求交
+     * 光线起点相同且各轴方向符号一致时（如针孔相机的主光线），先用区间算术对整组光线做保守剔除
+     */
+    void hit_packet(const ray *rays, int count, real t_min, real *t_max, hit_record *recs,
+                    uint32_t &hit_mask) const override
+    {
+        ray_data data[max_packet_size];
+        for (int k = 0; k < count; ++k)
+            data[k] = ray_data(rays[k]);
+
+        packet_bounds packet;
+        bool coherent = make_packet_bounds(rays, data, count, packet);
+
+        struct stack_entry
+        {
+            int node;
+            uint32_t mask; // 需要访问该节点的光线
+        };
+        stack_entry local_stack[max_stack_size];
+        std::vector<stack_entry> heap_stack;
+        stack_entry *to_visit = local_stack;
+        if (3 * tree_depth + 1 > max_stack_size)
+        {
+            heap_stack.resize(3 * tree_depth + 1);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        to_visit[stack_size++] = {0, (count >= 32 ? ~0u : (1u << count) - 1)};
+
+        while (stack_size > 0)
+        {
+            stack_entry entry = to_visit[--stack_size];
+            const bvh4_node &node = nodes[entry.node];
+
+            // 整组光线都不可能与某个孩子相交时直接剔除
+            int possible = 0xf;
+            if (coherent)
+            {
+                real packet_t_max = t_min;
+                for (uint32_t m = entry.mask; m; m &= m - 1)
+                    packet_t_max = std::fmax(packet_t_max, t_max[lowest_bit(m)]);
+                possible = intersect_packet(node, packet, t_min, packet_t_max);
+                if (possible == 0)
+                    continue;
+            }
+
+            uint32_t child_rays[4] = {0, 0, 0, 0};
+            const float inf = std::numeric_limits<float>::infinity();
+            float child_near[4] = {inf, inf, inf, inf};
+            for (uint32_t m = entry.mask; m; m &= m - 1)
+            {
+                int k = lowest_bit(m);
+                float t_near[4];
+                int ray_mask = intersect(node, data[k], interval(t_min, t_max[k]), t_near) & possible;
+                for (int c = 0; c < 4; ++c)
+                {
+                    if (ray_mask & (1 << c))
+                    {
+                        child_rays[c] |= 1u << k;
+                        child_near[c] = std::fmin(child_near[c], t_near[c]);
+                    }
+                }
+            }
+
+            // 按组内最近的进入距离从近到远排列孩子
+            int order[4];
+            int hit_num = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                if (child_rays[c] == 0)
+                    continue;
+                int k = hit_num++;
+                while (k > 0 && child_near[order[k - 1]] > child_near[c])
+                {
+                    order[k] = order[k - 1];
+                    --k;
+                }
+                order[k] = c;
+            }
+
+            for (int n = 0; n < hit_num; ++n)
+            {
+                int c = order[n];
+                if (node.count[c] == 0)
+                    continue;
+                for (uint32_t m = child_rays[c]; m; m &= m - 1)
+                {
+                    int k = lowest_bit(m);
+                    for (int i = 0; i < node.count[c]; ++i)
+                    {
+                        if (primitives[node.child[c] + i]->hit(rays[k], interval(t_min, t_max[k]), recs[k]))
+                        {
+                            t_max[k] = recs[k].t;
+                            hit_mask |= 1u << k;
+                        }
+                    }
+                }
+            }
+            for (int n = hit_num - 1; n >= 0; --n)
+            {
+                int c = order[n];
+                if (node.count[c] == 0)
+                    to_visit[stack_size++] = {node.child[c], child_rays[c]};
+            }
+        }
+    }
+
+    aabb bounding_box() const override
+    {
+        return bbox;
+    }
+
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        for (const auto &primitive : primitives)
+            primitive->collect_lights(lights);
+    }
+
+    size_t node_count() const
+    {
+        return nodes.size();
+    }
+
+  private:
+    static constexpr int max_stack_size = 192;
+
+    std::vector<bvh4_node> nodes;
+    std::vector<shared_ptr<hittable>> primitives;
+    aabb bbox;
+    int tree_depth = 0;
+
+    struct ray_data
+    {
+        float orig[3];
+        float inv_dir[3];
+        bool dir_is_neg[3];
+
+        ray_data()
+        {
+        }
+
+        ray_data(const ray &r)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                orig[axis] = static_cast<float>(r.origin()[axis]);
+                inv_dir[axis] = static_cast<float>(1 / r.direction()[axis]);
+                dir_is_neg[axis] = inv_dir[axis] < 0;
+            }
+        }
+    };
+
+    // 一组光线的公共起点和各轴方向倒数的取值范围
+    struct packet_bounds
+    {
+        float orig[3];
+        float inv_min[3], inv_max[3];
+        bool dir_is_neg[3];
+    };
+
+    static int lowest_bit(uint32_t mask)
+    {
+        return __builtin_ctz(mask);
+    }
+
+    /**
+     * @brief 计算区间算术需要的范围，要求所有光线起点相同、各轴方向符号一致
+     *
+     * @return 是否可以对这组光线使用区间算术剔除
+     */
+    static bool make_packet_bounds(const ray *rays, const ray_data *data, int count, packet_bounds &packet)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            packet.orig[axis] = data[0].orig[axis];
+            packet.inv_min[axis] = packet.inv_max[axis] = data[0].inv_dir[axis];
+            packet.dir_is_neg[axis] = data[0].dir_is_neg[axis];
+        }
+
+        for (int k = 1; k < count; ++k)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (rays[k].origin()[axis] != rays[0].origin()[axis] ||
+                    data[k].dir_is_neg[axis] != packet.dir_is_neg[axis])
+                    return false;
+                packet.inv_min[axis] = std::fmin(packet.inv_min[axis], data[k].inv_dir[axis]);
+                packet.inv_max[axis] = std::fmax(packet.inv_max[axis], data[k].inv_dir[axis]);
+            }
+        }
+
+        // 方向分量为0时倒数为无穷，区间算术会产生NaN，不做剔除
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (!std::isfinite(packet.inv_min[axis]) || !std::isfinite(packet.inv_max[axis]))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 区间算术：对每个孩子求出组内所有光线进入距离的下界和离开距离的上界，
+     * 下界大于上界说明组内没有光线与该bbox相交
+     *
+     * @return 可能与组内光线相交的孩子的位掩码
+     */
+    static int intersect_packet(const bvh4_node &node, const packet_bounds &packet, real t_min, real t_max)
+    {
+        const float far_scale = 1 + 2 * 3 * std::numeric_limits<float>::epsilon();
+        int mask = 0;
+
+        for (int c = 0; c < 4; ++c)
+        {
+            float entry = static_cast<float>(t_min);
+            float exit = static_cast<float>(std::fmin(t_max, std::numeric_limits<float>::max()));
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                // 方向符号一致，所有光线的近平面和远平面相同
+                float near_dist = node.bounds[packet.dir_is_neg[axis] ? axis + 3 : axis][c] - packet.orig[axis];
+                float far_dist = node.bounds[packet.dir_is_neg[axis] ? axis : axis + 3][c] - packet.orig[axis];
+                float near_lo = std::fmin(near_dist * packet.inv_min[axis], near_dist * packet.inv_max[axis]);
+                float far_hi = std::fmax(far_dist * packet.inv_min[axis], far_dist * packet.inv_max[axis]);
+                entry = std::fmax(entry, near_lo);
+                exit = std::fmin(exit, far_hi * far_scale);
+            }
+            // 空位的bbox为无穷，计算结果可能为NaN，此时比较为false，同样被剔除
+            if (entry <= exit)
+                mask |= 1 << c;
+        }
+        return mask;
+    }
+
+    /**
+     * @brief 光线与节点的四个bbox求交
+     *
+     * @param t_near 输出每个bbox的进入距离
+     * @return 相交的孩子的位掩码
+     */
+    static int intersect(const bvh4_node &node, const ray_data &data, const interval &ray_t, float t_near[4])
+    {
+        // 远平面距离放大一点，抵消float计算的舍入误差，避免漏掉擦边的bbox
+        const float far_scale = 1 + 2 * 3 * std::numeric_limits<float>::epsilon();
+
+#if defined(__SSE2__)
+        __m128 t_min = _mm_set1_ps(static_cast<float>(ray_t.min));
+        __m128 t_max = _mm_set1_ps(static_cast<float>(std::fmin(ray_t.max, std::numeric_limits<float>::max())));
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            // 根据方向符号直接选出近平面和远平面
+            const float *near_plane = node.bounds[data.dir_is_neg[axis] ? axis + 3 : axis];
+            const float *far_plane = node.bounds[data.dir_is_neg[axis] ? axis : axis + 3];
+            __m128 orig = _mm_set1_ps(data.orig[axis]);
+            __m128 inv_dir = _mm_set1_ps(data.inv_dir[axis]);
+
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_plane), orig), inv_dir);
+            __m128 t1 = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_plane), orig), inv_dir),
+                                   _mm_set1_ps(far_scale));
+            // 出现NaN时max/min返回第二个操作数，即保留原有区间
+            t_min = _mm_max_ps(t0, t_min);
+            t_max = _mm_min_ps(t1, t_max);
+        }
+
+        _mm_storeu_ps(t_near, t_min);
+        return _mm_movemask_ps(_mm_cmple_ps(t_min, t_max));
+#else
+        int mask = 0;
+        for (int c = 0; c < 4; ++c)
+        {
+            float t_min = static_cast<float>(ray_t.min);
+            float t_max = static_cast<float>(std::fmin(ray_t.max, std::numeric_limits<float>::max()));
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float near_plane = node.bounds[data.dir_is_neg[axis] ? axis + 3 : axis][c];
+                float far_plane = node.bounds[data.dir_is_neg[axis] ? axis : axis + 3][c];
+                float t0 = (near_plane - data.orig[axis]) * data.inv_dir[axis];
+                float t1 = (far_plane - data.orig[axis]) * data.inv_dir[axis] * far_scale;
+                if (t0 > t_min)
+                    t_min = t0;
+                if (t1 < t_max)
+                    t_max = t1;
+            }
+            t_near[c] = t_min;
+            if (t_min <= t_max)
+                mask |= 1 << c;
+        }
+        return mask;
+#endif
+    }
+
+    static float round_down(double x)
+    {
+        float f = static_cast<float>(x);
+        return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float round_up(double x)
+    {
+        float f = static_cast<float>(x);
+        return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static void set_bounds(bvh4_node &node, int c, const aabb &box)
+    {
+        const interval *axes[3] = {&box.x, &box.y, &box.z};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.bounds[axis][c] = round_down(axes[axis]->min);
+            node.bounds[axis + 3][c] = round_up(axes[axis]->max);
+        }
+    }
+
+    static bool is_leaf_pair(const bvh_node &node)
+    {
+        return !std::dynamic_pointer_cast<bvh_node>(node.left) && !std::dynamic_pointer_cast<bvh_node>(node.right);
+    }
+
+    /**
+     * @brief 将二叉树中以node为根的至多两层折叠为一个四叉节点，返回节点下标
+     */
+    int build(const bvh_node &root, int depth)
+    {
+        tree_depth = std::max(tree_depth, depth);
+
+        // 不断展开面积最大的内部节点，直到凑满四个孩子
+        std::vector<shared_ptr<hittable>> children = {root.left};
+        if (root.right != root.left)
+            children.push_back(root.right);
+
+        while (children.size() < 4)
+        {
+            int expand = -1;
+            double max_area = -1;
+            for (size_t c = 0; c < children.size(); ++c)
+            {
+                auto child_node = std::dynamic_pointer_cast<bvh_node>(children[c]);
+                if (child_node && !is_leaf_pair(*child_node) && child_node->bbox.surface_area() > max_area)
+                {
+                    max_area = child_node->bbox.surface_area();
+                    expand = int(c);
+                }
+            }
+            if (expand < 0)
+                break;
+
+            auto child_node = std::dynamic_pointer_cast<bvh_node>(children[expand]);
+            children[expand] = child_node->left;
+            children.insert(children.begin() + expand + 1, child_node->right);
+        }
+
+        int index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        for (int c = 0; c < 4; ++c)
+        {
+            // 空位的bbox为空，任何光线都不会与之相交
+            set_bounds(nodes[index], c, aabb::empty);
+            nodes[index].child[c] = -1;
+            nodes[index].count[c] = 0;
+        }
+
+        for (size_t c = 0; c < children.size(); ++c)
+        {
+            auto child_node = std::dynamic_pointer_cast<bvh_node>(children[c]);
+            set_bounds(nodes[index], int(c), children[c]->bounding_box());
+
+            if (!child_node)
+            {
+                // 单个物体作为叶子
+                nodes[index].child[c] = static_cast<int32_t>(primitives.size());
+                nodes[index].count[c] = 1;
+                primitives.push_back(children[c]);
+            }
+            else if (is_leaf_pair(*child_node))
+            {
+                // 两个孩子都是物体的节点直接作为叶子
+                nodes[index].child[c] = static_cast<int32_t>(primitives.size());
+                primitives.push_back(child_node->left);
+                if (child_node->right != child_node->left)
+                    primitives.push_back(child_node->right);
+                nodes[index].count[c] = static_cast<uint8_t>(primitives.size() - nodes[index].child[c]);
+            }
+            else
+            {
+                int child_index = build(*child_node, depth + 1);
+                nodes[index].child[c] = child_index;
+            }
+        }
+
+        return index;
+    }
+};
+
+#endif // !BVH4_H
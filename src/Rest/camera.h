@@ -3,18 +3,27 @@
 
 #include "color.h"
 #include "dynamic_thread_pool.h"
+#include "environment_map.h"
 #include "global.h"
 #include "hittable.h"
+#include "image_writer.h"
+#include "light_list.h"
 #include "material.h"
 #include "vec3.h"
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cmath>
+#include <fstream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 class camera
 
@@ -23,10 +32,12 @@ class camera
     double aspect_ratio = 1.0;  // 默认宽高比
     int image_width = 100;      // 默认图片宽度为100像素
     int samples_per_pixel = 10; // 每个像素采样次数
-    int max_depth = 10;         // 每次递归最大深度
+    int max_depth = 10;         // 每条路径最大弹射次数
     double vfov = 90;           // 垂直方向的fov
     color background;           // 场景背景颜色，默认是黑色
 
+    shared_ptr<environment_map> environment; // 环境光，不为空时代替background，light_sampling为true时参与光源采样
+
     point3 lookfrom = point3(0, 0, 0); // 相机所在位置
     point3 lookat = point3(0, 0, -1);  // 相机看向的位置（确定相机朝向）
     //! 注意：vup不是相机相对正上方，只是用来和相机看向的方向一起确定一个平面，从而计算出相机的x轴
@@ -35,33 +46,74 @@ class camera
     double defocus_angle = 0; // 光线穿过像素时角度变化范围
     double focus_dis = 10;    // 相机到完美对焦平面的距离
 
-    void render(const hittable &world)
-    {
-        initialize();
+    int russian_roulette_depth = 5; // 弹射次数达到该值后开始俄罗斯轮盘赌，为0表示关闭
+    bool packet_tracing = false;    // 为true时主光线按4*4像素块成组求交，自适应采样时不使用
+    bool wavefront = false;         // 为true时使用波前式路径追踪，交点按材质类型分组着色，自适应采样时不使用
+    int wavefront_size = 4096;      // 波前式路径追踪每一批的路径数
+    bool light_sampling = true;     // 为true时在漫反射表面和介质中对光源直接采样，并与散射采样做多重重要性采样
 
-        std::cout << "P3" << std::endl;
-        std::cout << image_width << " " << image_height << std::endl;
-        std::cout << "255" << std::endl;
+    image_format output_format = image_format::ppm; // 输出图片格式，默认为二进制PPM
 
-        RenderScene(world, 0, image_height, 0, image_width);
+    // 自适应采样的相对误差阈值，为0表示关闭；开启时samples_per_pixel是平均每个像素的采样预算，
+    // 收敛的像素节省下来的采样分配给误差最大的像素
+    double adaptive_threshold = 0;
+    int adaptive_min_samples = 16; // 自适应采样每个像素的最少采样数
+    int adaptive_max_samples = 0;  // 自适应采样每个像素的最多采样数，为0表示4 * samples_per_pixel
 
-        std::clog << "\rDone.                 " << std::endl;
+    bool deterministic = false; // 为true时每个采样的随机数只由seed、像素和采样编号决定，渲染结果可复现
+    uint64_t seed = 0;          // 可复现模式下的随机数种子，同时作为低差异序列扰乱的种子
+
+    // 采样器，sobol时每个采样的镜头、时间、散射方向、光源采样等维度依次取自每个像素独立扰乱的Sobol序列
+    sampler_type sampler = sampler_type::independent;
+
+    double time_limit = 0;     // 渐进式渲染的时间上限（秒），为0表示不限制
+    std::string progress_file; // 渐进式渲染每一轮结束后写入中间结果的文件，为空表示不写入
+
+    int thread_count = 0; // 多线程渲染使用的线程数，为0表示使用硬件线程数
+
+    // 最近一次渲染的耗时（秒），由渲染函数写入
+    double trace_seconds = 0;  // 追踪光线、计算像素颜色
+    double output_seconds = 0; // 编码并输出图片
+
+    void render(const hittable &world)
+    {
+        initialize(world);
+        auto start_time = std::chrono::steady_clock::now();
 
-        for (int j = 0; j < image_height; ++j)
+        if (adaptive_threshold > 0)
         {
-            for (int i = 0; i < image_width; ++i)
-            {
-                write_color(std::cout, framebuffer[j * image_width + i]);
-            }
+            RenderAdaptive(adaptive_batch_size, [&world, this]() {
+                RenderPending(world, 0, image_height, 0, image_width);
+            }, []() { return true; });
         }
+        else
+        {
+            RenderScene(world, 0, image_height, 0, image_width);
+        }
+
+        std::clog << "\rDone.                 " << std::endl;
+        ReportSamples();
+        Output(start_time);
     }
+
+    /**
+     * @brief 按行分段、每段一个线程渲染；开启自适应采样时不创建线程，在当前线程逐轮渲染
+     */
     void ThreadRender(const hittable &world)
     {
-        initialize();
+        initialize(world);
 
-        std::cout << "P3" << std::endl;
-        std::cout << image_width << " " << image_height << std::endl;
-        std::cout << "255" << std::endl;
+        // 自适应采样每一轮都要在整张图片上选择像素，这里直接在当前线程逐轮渲染
+        if (adaptive_threshold > 0)
+        {
+            RenderAdaptive(adaptive_batch_size, [&world, this]() {
+                RenderPending(world, 0, image_height, 0, image_width);
+            }, []() { return true; });
+            std::clog << "\rDone.                 " << std::endl;
+            ReportSamples();
+            write_image(std::cout, output_format, image_width, image_height, framebuffer);
+            return;
+        }
 
         // 多线程
         // 创建一个线程向量，用于存储所有线程
@@ -99,13 +151,9 @@ class camera
         }
 
         std::clog << "\rDone.                 " << std::endl;
-        for (int j = 0; j < image_height; ++j)
-        {
-            for (int i = 0; i < image_width; ++i)
-            {
-                write_color(std::cout, framebuffer[j * image_width + i]);
-            }
-        }
+        ReportSamples();
+        // 输出渲染的结果
+        write_image(std::cout, output_format, image_width, image_height, framebuffer);
     }
 
     /**
@@ -115,24 +163,17 @@ class camera
      */
     void ThreadPoolRender(const hittable &world, int chunk_size = 12)
     {
-        initialize();
-
-        std::cout << "P3" << std::endl;
-        std::cout << image_width << " " << image_height << std::endl;
-        std::cout << "255" << std::endl;
+        initialize(world);
 
         std::mutex mtx; // 创建互斥量
 
-        int hardware_concurrency = std::thread::hardware_concurrency();
-        // int hardware_concurrency = 10;
-        if (hardware_concurrency <= 0)
-            hardware_concurrency = 1;
+        auto start_time = std::chrono::steady_clock::now();
+
+        int hardware_concurrency = ThreadCount();
 
         std::clog << "Threads: " << hardware_concurrency << std::endl;
 
-        std::atomic<int> lines(0);
         DynamicThreadPool thread_pool(hardware_concurrency);
-        std::vector<std::future<void>> futures;
 
         // 设置一个合适的任务块大小（例如一次处理10行）
         // int chunk_size = std::max(image_height / (4 * hardware_concurrency), 1);
@@ -141,34 +182,86 @@ class camera
             chunk_size = 1;
         std::clog << "Chunk size: " << chunk_size << std::endl;
 
-        for (int j = 0; j < image_height; j += chunk_size)
-        // for (int j = 0; j < hardware_concurrency; ++j)
+        if (adaptive_threshold > 0)
         {
-            for (int i = 0; i < image_width; i += chunk_size)
-            // for (int i = 0; i < 1; i += chunk_size)
-            {
-
-                int end_y = std::min(j + chunk_size, image_height);
-                int end_x = std::min(i + chunk_size, image_width);
-                futures.emplace_back(thread_pool.enqueue(
-                    [&world, j, end_y, i, end_x, this]() { RenderScene(world, j, end_y, i, end_x); }));
-            }
+            RenderAdaptive(adaptive_batch_size, [&world, &thread_pool, chunk_size, this]() {
+                RenderPendingTiles(world, thread_pool, chunk_size);
+            }, []() { return true; });
         }
-
-        for (auto &fut : futures)
+        else
         {
-            fut.get();
+            DispatchTiles(thread_pool, chunk_size, [&world, this](int start_y, int end_y, int start_x, int end_x) {
+                RenderScene(world, start_y, end_y, start_x, end_x);
+            });
         }
 
         std::clog << "\rDone.                 " << std::endl;
-        // 输出渲染的结果
-        for (int j = 0; j < image_height; ++j)
+        ReportSamples();
+        Output(start_time);
+    }
+
+    /**
+     * @brief 渐进式渲染：每一轮为所有像素增加samples_per_pass个采样并累加，每轮结束后输出中间结果，
+     * 达到samples_per_pixel或超过time_limit秒时停止
+     * 开启自适应采样时每一轮只为未收敛的像素增加采样，预算不足时优先误差最大的像素，所有像素收敛或预算用完时停止
+     *
+     * @param world
+     * @param samples_per_pass 每一轮每个像素的采样数
+     */
+    void ProgressiveRender(const hittable &world, int samples_per_pass, int chunk_size = 12)
+    {
+        initialize(world);
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        int hardware_concurrency = ThreadCount();
+        std::clog << "Threads: " << hardware_concurrency << std::endl;
+
+        DynamicThreadPool thread_pool(hardware_concurrency);
+        samples_per_pass = std::max(samples_per_pass, 1);
+
+        if (adaptive_threshold > 0)
+        {
+            RenderAdaptive(samples_per_pass, [&world, &thread_pool, chunk_size, this]() {
+                RenderPendingTiles(world, thread_pool, chunk_size);
+            }, [start_time, this]() {
+                return FinishPass(start_time, double(samples_taken) / (image_width * image_height));
+            });
+
+            std::clog << "\rDone.                 " << std::endl;
+            ReportSamples();
+            Output(start_time);
+            return;
+        }
+
+        // 累加所有轮次的采样结果，framebuffer保存当前的平均值
+        std::vector<color> accumulation(image_height * image_width);
+        int total_samples = 0;
+
+        while (total_samples < samples_per_pixel)
         {
-            for (int i = 0; i < image_width; ++i)
+            int pass_samples = std::min(samples_per_pass, samples_per_pixel - total_samples);
+
+            DispatchTiles(thread_pool, chunk_size,
+                          [&world, &accumulation, total_samples, pass_samples, this](int start_y, int end_y,
+                                                                                     int start_x, int end_x) {
+                              RenderPass(world, accumulation, total_samples, pass_samples, start_y, end_y, start_x,
+                                         end_x);
+                          });
+
+            total_samples += pass_samples;
+            double scale = 1.0 / total_samples;
+            for (size_t index = 0; index < accumulation.size(); ++index)
             {
-                write_color(std::cout, framebuffer[j * image_width + i]);
+                framebuffer[index] = accumulation[index] * scale;
             }
+
+            if (!FinishPass(start_time, total_samples))
+                break;
         }
+
+        std::clog << "\rDone.                 " << std::endl;
+        Output(start_time);
     }
 
   private:
@@ -185,10 +278,30 @@ class camera
     vec3 defocus_disk_u; // 散焦时水平方向向量
     vec3 defocus_disk_v; // 散焦时垂直方向向量
     std::atomic<int> lines;
+    std::atomic<long long> samples_taken; // 自适应采样实际使用的采样总数
+
+    // 自适应采样中一个像素的统计量
+    struct adaptive_pixel
+    {
+        color sum;       // 所有采样颜色之和
+        double mean = 0; // 亮度的均值
+        double m2 = 0;   // 亮度与均值之差的平方和
+        int samples = 0;
+        int pending = 0; // 本轮要增加的采样数
+    };
+    std::vector<adaptive_pixel> adaptive_pixels;
+    std::vector<std::pair<double, int>> adaptive_candidates; // (误差, 像素编号)，每一轮重复使用
+    static constexpr int adaptive_batch_size = 8;
     std::vector<color> framebuffer;
+    light_list lights; // 直接采样的光源，light_sampling为false时为空
 
-    void initialize()
+    void initialize(const hittable &world)
     {
+        if (light_sampling)
+            lights.build(world, environment.get());
+        else
+            lights.clear();
+
         image_height = int(image_width / aspect_ratio);
         image_height = (image_height < 1) ? 1 : image_height;
         // pixel_sample_scale = 1.0 / samples_per_pixel;
@@ -198,6 +311,7 @@ class camera
 
         framebuffer.resize(image_height * image_width);
         lines = 0;
+        samples_taken = 0;
 
         // 设置摄像机属性
 
@@ -244,46 +358,161 @@ class camera
     {
         if (depth <= 0)
             return color(0, 0, 0);
+
         hit_record rec;
-        if (world.hit(r, interval(0.001, infinity), rec))
-        {
-            // return 0.5 * (rec.normal + vec3(1, 1, 1));
+        bool hit = world.hit(r, interval(ray_t_min, infinity), rec);
+        return trace_path(r, rec, hit, depth, world);
+    }
+
+    /**
+     * @brief 迭代地追踪一条路径，记录路径吞吐量（累计衰减）和累计的辐射亮度，避免递归
+     * 弹射次数达到russian_roulette_depth后，按吞吐量的最大分量作为概率继续追踪（俄罗斯轮盘赌）
+     *
+     * @param r 相机发出的光线
+     * @param rec 光线r的第一个交点，之后用于保存每次弹射的交点
+     * @param hit 光线r是否与场景相交
+     * @param depth 最大弹射次数
+     * @param world 场景
+     * @return 光线带回的颜色
+     */
+    color trace_path(const ray &r, hit_record &rec, bool hit, int depth, const hittable &world) const
+    {
+        color radiance(0, 0, 0);
+        // 此处的throughput是到目前为止所有衰减率的乘积
+        color throughput(1, 1, 1);
+        ray current = r;
+        // 生成current时散射方向的概率密度，为0表示上一个交点没有对光源采样（相机光线、镜面反射和折射）
+        real scatter_pdf = 0;
 
-            // 生成反射光线的方向
-            // vec3 direction = random_on_hemisphere(rec.normal);
+        for (int bounce = 0; bounce < depth; ++bounce)
+        {
+            if (bounce > 0)
+                hit = world.hit(current, interval(ray_t_min, infinity), rec);
+            if (!hit)
+            {
+                // 背景颜色
+                radiance += throughput * Background(current, scatter_pdf);
+                break;
+            }
+            rec.finish(current);
 
-            // lambertian 模型
-            // vec3 direction = rec.normal + random_unit_vector();
-            // // 吸收周围颜色的50%，反射剩余的50%，呈现一种灰色
-            // // 此处0.5与之前不同，之前是为了保证颜色取值在[0, 1]之间
-            // return 0.5 * ray_color(ray(rec.p, direction), depth - 1, world);
+            // 自发光，上一个交点已经对光源采样时按多重重要性采样加权
+            color emitted = rec.mat->emitted(rec.u, rec.v, rec.p);
+            if (scatter_pdf > 0 && !is_black(emitted))
+                emitted *= EmissionWeight(current, rec, scatter_pdf);
+            radiance += throughput * emitted;
 
-            // 添加材质
             ray scattered;
             // 此处的attenuation是衰退率，即经过反射后仍然保留的颜色所占比例，不是反射的颜色
-            // 不同材质的albedo也是反射率的含义，而非颜色
             color attenuation;
+            if (!rec.mat->scatter(current, rec, attenuation, scattered))
+                break;
+
+            // 直接光照，最后一次弹射不采样，保证被采样的光源同样可以由散射光线击中
+            scatter_pdf = 0;
+            if (!lights.empty() && bounce + 1 < depth && rec.mat->samples_lights())
+            {
+                radiance += throughput * SampleLight(world, *rec.mat, current, rec);
+                scatter_pdf = rec.mat->scattering_pdf(current, rec, scattered.direction());
+            }
 
-            // 自发光
-            color color_from_emission = rec.mat->emitted(rec.u, rec.v, rec.p);
+            throughput = throughput * attenuation;
 
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
+            // 俄罗斯轮盘赌：贡献小的路径大概率提前终止，存活的路径除以概率保持无偏
+            if (russian_roulette_depth > 0 && bounce + 1 >= russian_roulette_depth)
             {
-                // 反射光
-                color color_from_scatter = attenuation * ray_color(scattered, depth - 1, world);
-                return color_from_emission + color_from_scatter;
+                double max_component = std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z()));
+                double survive = std::fmin(max_component, 0.95);
+                if (random_double() >= survive)
+                    break;
+                throughput /= survive;
             }
-            return color_from_emission;
+
+            current = scattered;
+        }
+
+        return radiance;
+    }
+
+    static bool is_black(const color &c)
+    {
+        return c.x() <= 0 && c.y() <= 0 && c.z() <= 0;
+    }
+
+    // 多重重要性采样的幂启发式权重（指数为2），pdf_a为当前采样策略的概率密度
+    static real power_heuristic(real pdf_a, real pdf_b)
+    {
+        real a = pdf_a * pdf_a;
+        real b = pdf_b * pdf_b;
+        return a / (a + b);
+    }
+
+    /**
+     * @brief 直接光照：选择一个光源并在其表面采样一点，发射阴影光线，未被遮挡时按多重重要性采样加权返回贡献
+     * M为final的具体材质类型时材质的虚函数调用会被去虚化
+     *
+     * @param r_in 击中rec的光线
+     * @return 不含路径吞吐量的直接光照
+     */
+    template <class M>
+    color SampleLight(const hittable &world, const M &mat, const ray &r_in, const hit_record &rec) const
+    {
+        light_sample sample;
+        if (!lights.sample(rec.p, sample))
+            return color(0, 0, 0);
+
+        // 环境光在无穷远处，阴影光线没有终点
+        vec3 direction = sample.direction;
+        real shadow_max = infinity;
+        if (!sample.infinite)
+        {
+            vec3 to_light = sample.p - rec.p;
+            real distance = to_light.length();
+            if (distance <= 2 * ray_t_min)
+                return color(0, 0, 0);
+            direction = to_light / distance;
+            // 阴影光线在到达光源之前停止，不会与光源自身相交
+            shadow_max = distance - ray_t_min;
         }
-        // 天空颜色
-        // vec3 unit_direction = unit(r.direction());
-        // double t = 0.5 * (unit_direction.y() + 1.0);
-        // color start_color = color(1.0, 1.0, 1.0);
-        // color end_color = color(0.5, 0.7, 1.0);
-        // return (1.0 - t) * start_color + t * end_color;
 
-        // 背景颜色
-        return background;
+        color value = mat.eval(r_in, rec, direction);
+        if (is_black(value))
+            return color(0, 0, 0);
+        color emitted = sample.infinite ? sample.radiance : sample.mat->emitted(sample.u, sample.v, sample.p);
+        if (is_black(emitted))
+            return color(0, 0, 0);
+
+        if (world.occluded(ray(rec.p, direction, r_in.time()), interval(ray_t_min, shadow_max)))
+            return color(0, 0, 0);
+
+        real weight = power_heuristic(sample.pdf, mat.scattering_pdf(r_in, rec, direction));
+        return value * emitted * (weight / sample.pdf);
+    }
+
+    /**
+     * @brief 散射光线r击中光源时自发光的多重重要性采样权重
+     *
+     * @param scatter_pdf 生成r的散射方向的概率密度
+     */
+    real EmissionWeight(const ray &r, const hit_record &rec, real scatter_pdf) const
+    {
+        return power_heuristic(scatter_pdf, lights.pdf(r.origin(), rec));
+    }
+
+    /**
+     * @brief 没有击中任何物体的光线r带回的背景辐射亮度，环境光按多重重要性采样加权
+     *
+     * @param scatter_pdf 生成r的散射方向的概率密度，为0表示上一个交点没有对光源采样
+     */
+    color Background(const ray &r, real scatter_pdf) const
+    {
+        if (!environment)
+            return background;
+        vec3 direction = unit(r.direction());
+        color value = environment->eval(direction);
+        if (scatter_pdf > 0 && !is_black(value))
+            value *= power_heuristic(scatter_pdf, lights.environment_pdf(direction));
+        return value;
     }
 
     ray get_ray(int i, int j, int si, int sj)
@@ -316,7 +545,9 @@ class camera
      */
     point3 sample_squre() const
     {
-        return point3(random_double() - 0.5, random_double() - 0.5, 0);
+        double x, y;
+        random_double_2d(x, y);
+        return point3(x - 0.5, y - 0.5, 0);
     }
 
     point3 sample_defocus_disk() const
@@ -325,8 +556,553 @@ class camera
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
+    /**
+     * @brief 将图片划分为chunk_size * chunk_size的方块并行渲染，返回时所有方块都已完成
+     * 每个工作线程只提交一个任务，线程从原子计数器中领取方块编号，渲染时不再为每个方块分配内存
+     *
+     * @param render_tile 渲染一个方块的函数，参数为start_y, end_y, start_x, end_x
+     */
+    template <class F> void DispatchTiles(DynamicThreadPool &thread_pool, int chunk_size, F render_tile)
+    {
+        int tiles_x = (image_width + chunk_size - 1) / chunk_size;
+        int tiles_y = (image_height + chunk_size - 1) / chunk_size;
+        int tile_count = tiles_x * tiles_y;
+        std::atomic<int> next_tile(0);
+
+        for (size_t worker = 0; worker < thread_pool.size(); ++worker)
+        {
+            thread_pool.submit([&render_tile, &next_tile, tile_count, tiles_x, chunk_size, this]() {
+                for (int tile = next_tile++; tile < tile_count; tile = next_tile++)
+                {
+                    int j = (tile / tiles_x) * chunk_size;
+                    int i = (tile % tiles_x) * chunk_size;
+                    int end_y = std::min(j + chunk_size, image_height);
+                    int end_x = std::min(i + chunk_size, image_width);
+                    render_tile(j, end_y, i, end_x);
+                }
+            });
+        }
+
+        // 所有方块渲染完成
+        thread_pool.wait();
+    }
+
+    /**
+     * @brief 为区域内每个像素增加sample_count个采样（编号从first_sample开始），结果累加到accumulation中
+     */
+    void RenderPass(const hittable &world, std::vector<color> &accumulation, int first_sample, int sample_count,
+                    int start_y, int end_y, int start_x, int end_x)
+    {
+        for (int j = start_y; j < end_y; ++j)
+        {
+            for (int i = start_x; i < end_x; ++i)
+            {
+                color pixel_color;
+                for (int s = 0; s < sample_count; ++s)
+                {
+                    BeginSample(i, j, first_sample + s);
+                    ray r = get_ray(i, j, 0, 0);
+                    pixel_color += ray_color(r, max_depth, world);
+                }
+                accumulation[j * image_width + i] += pixel_color;
+            }
+        }
+    }
+
+    /**
+     * @brief 开始像素(i, j)的第sample个采样，可复现模式下根据像素和采样编号重置随机数生成器，
+     * 使用Sobol采样器时从该像素的序列中取出第sample个点
+     */
+    void BeginSample(int i, int j, int sample) const
+    {
+        uint64_t pixel = uint64_t(j) * image_width + i;
+        if (deterministic)
+            seed_random_sample(seed, pixel, sample);
+        if (sampler == sampler_type::sobol)
+            start_sobol_sample(seed, pixel, sample);
+        else
+            stop_sobol_sample();
+    }
+
+    // 交错追踪多条路径时（成组追踪、波前式追踪）是否需要为每条路径保存自己的随机数状态
+    bool PerPathRandom() const
+    {
+        return deterministic || sampler != sampler_type::independent;
+    }
+
+    /**
+     * @brief 渐进式渲染一轮结束：输出进度和中间结果
+     *
+     * @param samples 目前平均每个像素的采样数
+     * @return 是否继续下一轮，超过time_limit时返回false
+     */
+    bool FinishPass(std::chrono::steady_clock::time_point start_time, double samples)
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::clog << "\rSamples: " << samples << "/" << samples_per_pixel << ", " << elapsed << "s " << std::flush;
+
+        // 输出中间结果，便于尽早发现有问题的渲染
+        if (!progress_file.empty())
+        {
+            std::ofstream out(progress_file, std::ios::binary);
+            write_image(out, output_format, image_width, image_height, framebuffer);
+        }
+
+        return !(time_limit > 0 && elapsed >= time_limit);
+    }
+
+    int AdaptiveMinSamples() const
+    {
+        // 至少需要两个采样才能估计方差
+        return std::max(adaptive_min_samples, 2);
+    }
+
+    int AdaptiveMaxSamples() const
+    {
+        int max_samples = adaptive_max_samples > 0 ? adaptive_max_samples : 4 * samples_per_pixel;
+        return std::max(max_samples, AdaptiveMinSamples());
+    }
+
+    /**
+     * @brief 像素均值的标准误差与允许误差之比，不大于1表示已收敛，采样数不足最少采样数时为无穷大
+     * 亮度很低的像素按一个最小亮度计算相对误差，避免暗部无限采样
+     */
+    double AdaptiveError(const adaptive_pixel &pixel) const
+    {
+        if (pixel.samples < AdaptiveMinSamples())
+            return std::numeric_limits<double>::infinity();
+        double std_error = std::sqrt(pixel.m2 / (pixel.samples - 1) / pixel.samples);
+        return std_error / (adaptive_threshold * std::max(pixel.mean, 0.01));
+    }
+
+    /**
+     * @brief 自适应采样：总预算为平均每个像素samples_per_pixel个采样（不少于最少采样数），
+     * 每一轮为未收敛且未达到上限的像素各增加batch个采样，剩余预算不够时只选择误差最大的像素，
+     * 收敛的像素节省下来的采样因此都用在噪声大的像素上。像素的统计量用Welford算法维护亮度的均值和方差
+     *
+     * @param batch 每一轮为每个选中的像素增加的采样数
+     * @param render_round 渲染一轮，对图片的各个区域调用RenderPending
+     * @param after_round 每一轮结束后调用，返回false时提前停止
+     */
+    template <class F, class G> void RenderAdaptive(int batch, F render_round, G after_round)
+    {
+        adaptive_pixels.assign(size_t(image_width) * image_height, adaptive_pixel());
+        long long budget = (long long)std::max(samples_per_pixel, AdaptiveMinSamples()) * image_width * image_height;
+
+        while (SelectAdaptivePixels(std::max(batch, 1), budget - samples_taken) > 0)
+        {
+            render_round();
+            if (!after_round())
+                break;
+        }
+    }
+
+    /**
+     * @brief 为本轮选中的像素设置pending
+     *
+     * @param batch 每个像素增加的采样数
+     * @param budget 剩余的采样预算
+     * @return 选中的像素数
+     */
+    int SelectAdaptivePixels(int batch, long long budget)
+    {
+        if (budget <= 0)
+            return 0;
+
+        int max_samples = AdaptiveMaxSamples();
+        adaptive_candidates.clear();
+        long long requested = 0;
+        for (size_t index = 0; index < adaptive_pixels.size(); ++index)
+        {
+            const adaptive_pixel &pixel = adaptive_pixels[index];
+            double error = AdaptiveError(pixel);
+            // 排序要求误差不是NaN
+            if (std::isnan(error))
+                error = std::numeric_limits<double>::infinity();
+            if (pixel.samples >= max_samples || error <= 1)
+                continue;
+            adaptive_candidates.emplace_back(error, int(index));
+            requested += std::min(batch, max_samples - pixel.samples);
+        }
+
+        // 预算不够时误差大的像素优先，误差相同时按像素顺序，保证结果与线程数无关
+        if (requested > budget)
+        {
+            std::sort(adaptive_candidates.begin(), adaptive_candidates.end(),
+                      [](const std::pair<double, int> &a, const std::pair<double, int> &b) {
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+        }
+
+        int selected = 0;
+        for (const auto &candidate : adaptive_candidates)
+        {
+            if (budget <= 0)
+                break;
+            adaptive_pixel &pixel = adaptive_pixels[candidate.second];
+            pixel.pending = int(std::min<long long>(std::min(batch, max_samples - pixel.samples), budget));
+            budget -= pixel.pending;
+            ++selected;
+        }
+
+        std::clog << "\rAdaptive pixels remaining: " << adaptive_candidates.size() << "    " << std::flush;
+        return selected;
+    }
+
+    /**
+     * @brief 为区域内本轮选中的像素增加pending个采样（编号接着该像素已有的采样），更新统计量和framebuffer
+     */
+    void RenderPending(const hittable &world, int start_y, int end_y, int start_x, int end_x)
+    {
+        long long taken = 0;
+        for (int j = start_y; j < end_y; ++j)
+        {
+            for (int i = start_x; i < end_x; ++i)
+            {
+                adaptive_pixel &pixel = adaptive_pixels[size_t(j) * image_width + i];
+                if (pixel.pending == 0)
+                    continue;
+
+                for (int s = 0; s < pixel.pending; ++s)
+                {
+                    BeginSample(i, j, pixel.samples);
+                    ray r = get_ray(i, j, 0, 0);
+                    color sample = ray_color(r, max_depth, world);
+                    // NaN或无穷大的采样按0计入，否则均值和方差变为NaN，像素永远不会收敛
+                    if (!std::isfinite(sample.x()) || !std::isfinite(sample.y()) || !std::isfinite(sample.z()))
+                        sample = color(0, 0, 0);
+                    pixel.sum += sample;
+
+                    double lum = luminance(sample);
+                    ++pixel.samples;
+                    double delta = lum - pixel.mean;
+                    pixel.mean += delta / pixel.samples;
+                    pixel.m2 += delta * (lum - pixel.mean);
+                }
+                taken += pixel.pending;
+                pixel.pending = 0;
+                framebuffer[j * image_width + i] = pixel.sum / pixel.samples;
+            }
+        }
+        samples_taken += taken;
+    }
+
+    // 在线程池中按方块并行执行RenderPending
+    void RenderPendingTiles(const hittable &world, DynamicThreadPool &thread_pool, int chunk_size)
+    {
+        DispatchTiles(thread_pool, chunk_size, [&world, this](int start_y, int end_y, int start_x, int end_x) {
+            RenderPending(world, start_y, end_y, start_x, end_x);
+        });
+    }
+
+    static double luminance(const color &c)
+    {
+        return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+    }
+
+    int ThreadCount() const
+    {
+        int count = thread_count > 0 ? thread_count : int(std::thread::hardware_concurrency());
+        return count > 0 ? count : 1;
+    }
+
+    /**
+     * @brief 记录从start_time开始的渲染耗时，然后输出渲染的结果并记录输出耗时
+     */
+    void Output(std::chrono::steady_clock::time_point start_time)
+    {
+        auto trace_end = std::chrono::steady_clock::now();
+        trace_seconds = std::chrono::duration<double>(trace_end - start_time).count();
+
+        write_image(std::cout, output_format, image_width, image_height, framebuffer);
+        std::cout.flush();
+        output_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trace_end).count();
+    }
+
+    void ReportSamples() const
+    {
+        if (adaptive_threshold > 0)
+        {
+            std::clog << "Average samples per pixel: " << double(samples_taken) / (image_width * image_height)
+                      << std::endl;
+        }
+    }
+
+    // 波前式路径追踪中一条正在追踪的路径
+    struct wavefront_path
+    {
+        ray r;
+        color throughput;   // 到目前为止所有衰减率的乘积
+        int id;             // 路径在这一批中的编号，对应radiance中的下标
+        random_state state; // 路径自己的随机数状态，PerPathRandom为true时使用
+        real scatter_pdf;   // 生成r的散射方向的概率密度，为0表示没有对光源采样
+    };
+
+    // 波前式路径追踪每个线程复用的缓冲区
+    struct wavefront_buffers
+    {
+        std::vector<wavefront_path> paths, next;
+        std::vector<hit_record> recs;
+        std::vector<int> order; // 按材质类型排序后的路径下标
+        std::vector<color> radiance;
+    };
+
+    /**
+     * @brief 对一类材质的所有交点集中着色：累加自发光，散射后存活的路径放入下一批
+     * M为final的具体材质类型时虚函数调用会被去虚化，M为material时通过虚函数着色
+     */
+    template <class M>
+    void ShadeWavefront(const hittable &world, wavefront_buffers &buffers, const int *first, const int *last,
+                        int bounce) const
+    {
+        for (const int *it = first; it != last; ++it)
+        {
+            wavefront_path &path = buffers.paths[*it];
+            const hit_record &rec = buffers.recs[*it];
+            const M *mat = static_cast<const M *>(rec.mat);
+            if (PerPathRandom())
+                restore_random_state(path.state);
+
+            color emitted = mat->emitted(rec.u, rec.v, rec.p);
+            if (path.scatter_pdf > 0 && !is_black(emitted))
+                emitted *= EmissionWeight(path.r, rec, path.scatter_pdf);
+            buffers.radiance[path.id] += path.throughput * emitted;
+
+            ray scattered;
+            color attenuation;
+            if (!mat->scatter(path.r, rec, attenuation, scattered))
+                continue;
+
+            // 与trace_path相同的直接光照，阴影光线在着色时立即追踪
+            path.scatter_pdf = 0;
+            if (!lights.empty() && bounce + 1 < max_depth && mat->samples_lights())
+            {
+                buffers.radiance[path.id] += path.throughput * SampleLight(world, *mat, path.r, rec);
+                path.scatter_pdf = mat->scattering_pdf(path.r, rec, scattered.direction());
+            }
+
+            path.throughput = path.throughput * attenuation;
+
+            // 与trace_path相同的俄罗斯轮盘赌
+            if (russian_roulette_depth > 0 && bounce + 1 >= russian_roulette_depth)
+            {
+                const color &throughput = path.throughput;
+                double max_component = std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z()));
+                double survive = std::fmin(max_component, 0.95);
+                if (random_double() >= survive)
+                    continue;
+                path.throughput /= survive;
+            }
+
+            path.r = scattered;
+            if (PerPathRandom())
+                path.state = save_random_state();
+            buffers.next.push_back(path);
+        }
+    }
+
+    /**
+     * @brief 波前式路径追踪：一批路径同时前进一次弹射，先对所有光线求交，
+     * 再将交点按材质类型分桶，每个桶在一个紧凑的循环里着色，存活的路径压缩后进入下一次弹射
+     * 可复现模式下每条路径携带自己的随机数状态，结果与逐条追踪一致
+     */
+    void RenderSceneWavefront(const hittable &world, int start_y, int end_y, int start_x, int end_x)
+    {
+        int width = end_x - start_x;
+        int tile_pixels = width * (end_y - start_y);
+        int total_samples = sqrt_spp * sqrt_spp;
+        int samples_per_batch = std::clamp(wavefront_size / tile_pixels, 1, total_samples);
+
+        wavefront_buffers buffers;
+        std::vector<color> pixel_color(tile_pixels);
+
+        for (int first = 0; first < total_samples; first += samples_per_batch)
+        {
+            int batch_samples = std::min(samples_per_batch, total_samples - first);
+
+            // 生成这一批的主光线，编号为采样*区域像素数+像素
+            buffers.paths.clear();
+            buffers.radiance.assign(size_t(batch_samples) * tile_pixels, color(0, 0, 0));
+            for (int s = 0; s < batch_samples; ++s)
+            {
+                int sample = first + s;
+                for (int p = 0; p < tile_pixels; ++p)
+                {
+                    int i = start_x + p % width, j = start_y + p / width;
+                    BeginSample(i, j, sample);
+                    ray r = get_ray(i, j, sample / sqrt_spp, sample % sqrt_spp);
+                    buffers.paths.push_back({r, color(1, 1, 1), s * tile_pixels + p, save_random_state(), 0});
+                }
+            }
+
+            for (int bounce = 0; bounce < max_depth && !buffers.paths.empty(); ++bounce)
+            {
+                size_t count = buffers.paths.size();
+                buffers.recs.resize(count);
+
+                // 求交，未击中的路径加上背景颜色后结束，按材质类型计数
+                std::array<int, material_kind_count + 1> offsets{};
+                size_t hits = 0;
+                for (size_t k = 0; k < count; ++k)
+                {
+                    wavefront_path &path = buffers.paths[k];
+                    if (PerPathRandom())
+                        restore_random_state(path.state);
+                    if (world.hit(path.r, interval(ray_t_min, infinity), buffers.recs[k]))
+                    {
+                        buffers.recs[k].finish(path.r);
+                        ++offsets[int(buffers.recs[k].mat->kind()) + 1];
+                        buffers.paths[hits] = path;
+                        buffers.recs[hits] = buffers.recs[k];
+                        if (PerPathRandom())
+                            buffers.paths[hits].state = save_random_state();
+                        ++hits;
+                    }
+                    else
+                    {
+                        buffers.radiance[path.id] += path.throughput * Background(path.r, path.scatter_pdf);
+                    }
+                }
+
+                // 计数排序，按材质类型分桶
+                for (int m = 0; m < material_kind_count; ++m)
+                    offsets[m + 1] += offsets[m];
+                buffers.order.resize(hits);
+                std::array<int, material_kind_count> cursor;
+                std::copy(offsets.begin(), offsets.end() - 1, cursor.begin());
+                for (size_t k = 0; k < hits; ++k)
+                    buffers.order[cursor[int(buffers.recs[k].mat->kind())]++] = int(k);
+
+                buffers.next.clear();
+                for (int m = 0; m < material_kind_count; ++m)
+                {
+                    const int *first_hit = buffers.order.data() + offsets[m];
+                    const int *last_hit = buffers.order.data() + offsets[m + 1];
+                    switch (material_kind(m))
+                    {
+                    case material_kind::lambertian:
+                        ShadeWavefront<lambertian>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    case material_kind::metal:
+                        ShadeWavefront<metal>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    case material_kind::dielectric:
+                        ShadeWavefront<dielectric>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    case material_kind::diffuse_light:
+                        ShadeWavefront<diffuse_light>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    case material_kind::isotropic:
+                        ShadeWavefront<isotropic>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    default:
+                        ShadeWavefront<material>(world, buffers, first_hit, last_hit, bounce);
+                        break;
+                    }
+                }
+
+                std::swap(buffers.paths, buffers.next);
+            }
+
+            // 按采样编号顺序累加到像素上
+            for (int s = 0; s < batch_samples; ++s)
+            {
+                for (int p = 0; p < tile_pixels; ++p)
+                    pixel_color[p] += buffers.radiance[size_t(s) * tile_pixels + p];
+            }
+        }
+
+        for (int p = 0; p < tile_pixels; ++p)
+        {
+            int i = start_x + p % width, j = start_y + p / width;
+            framebuffer[j * image_width + i] = pixel_color[p] * pixel_sample_scale;
+        }
+
+        if (start_x == 0)
+        {
+            lines += end_y - start_y;
+            std::clog << "\rScanline remaining: " << (image_height - lines) << " " << std::flush;
+        }
+    }
+
+    /**
+     * @brief 成组追踪主光线：区域按4*4的像素块划分，同一个块内同一编号的采样组成一组光线一起与场景求交，
+     * 之后每条路径的弹射仍然单独追踪
+     */
+    void RenderScenePacket(const hittable &world, int start_y, int end_y, int start_x, int end_x)
+    {
+        const int block = 4;
+        static_assert(block * block <= hittable::max_packet_size, "packet is too large");
+
+        for (int by = start_y; by < end_y; by += block)
+        {
+            int h = std::min(block, end_y - by);
+            for (int bx = start_x; bx < end_x; bx += block)
+            {
+                int w = std::min(block, end_x - bx);
+                int count = w * h;
+
+                color pixel_color[block * block];
+                for (int si = 0; si < sqrt_spp; ++si)
+                {
+                    for (int sj = 0; sj < sqrt_spp; ++sj)
+                    {
+                        ray rays[block * block];
+                        hit_record recs[block * block];
+                        real t_max[block * block];
+                        // 保存每条光线生成后的随机数状态，追踪路径前恢复，保证与逐条追踪结果一致
+                        random_state states[block * block];
+
+                        for (int k = 0; k < count; ++k)
+                        {
+                            int i = bx + k % w, j = by + k / w;
+                            BeginSample(i, j, si * sqrt_spp + sj);
+                            rays[k] = get_ray(i, j, si, sj);
+                            t_max[k] = infinity;
+                            if (PerPathRandom())
+                                states[k] = save_random_state();
+                        }
+
+                        uint32_t hit_mask = 0;
+                        if (max_depth > 0)
+                            world.hit_packet(rays, count, ray_t_min, t_max, recs, hit_mask);
+
+                        for (int k = 0; k < count; ++k)
+                        {
+                            if (PerPathRandom())
+                                restore_random_state(states[k]);
+                            pixel_color[k] += trace_path(rays[k], recs[k], (hit_mask >> k) & 1, max_depth, world);
+                        }
+                    }
+                }
+
+                for (int k = 0; k < count; ++k)
+                {
+                    framebuffer[(by + k / w) * image_width + bx + k % w] = pixel_color[k] * pixel_sample_scale;
+                }
+            }
+
+            if (start_x == 0)
+            {
+                lines += h;
+                std::clog << "\rScanline remaining: " << (image_height - lines) << " " << std::flush;
+            }
+        }
+    }
+
     void RenderScene(const hittable &world, int start_y, int end_y, int start_x, int end_x)
     {
+        if (wavefront)
+        {
+            RenderSceneWavefront(world, start_y, end_y, start_x, end_x);
+            return;
+        }
+        if (packet_tracing)
+        {
+            RenderScenePacket(world, start_y, end_y, start_x, end_x);
+            return;
+        }
+
         for (int j = start_y; j < end_y; ++j)
         {
             if (start_x == 0)
@@ -341,6 +1117,7 @@ class camera
                 {
                     for (int sj = 0; sj < sqrt_spp; ++sj)
                     {
+                        BeginSample(i, j, si * sqrt_spp + sj);
                         ray r = get_ray(i, j, si, sj);
                         pixel_color += ray_color(r, max_depth, world);
                     }
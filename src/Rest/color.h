@@ -9,7 +9,7 @@
 
 using color = vec3;
 
-inline double linear_to_gamma(double linear_component)
+inline real linear_to_gamma(real linear_component)
 {
     if (linear_component > 0)
         return std::sqrt(linear_component);
@@ -19,9 +19,9 @@ inline double linear_to_gamma(double linear_component)
 
 inline void write_color(std::ostream &out, const color &pixel_color)
 {
-    double r = pixel_color.x();
-    double g = pixel_color.y();
-    double b = pixel_color.z();
+    real r = pixel_color.x();
+    real g = pixel_color.y();
+    real b = pixel_color.z();
 
     r = linear_to_gamma(r);
     g = linear_to_gamma(g);
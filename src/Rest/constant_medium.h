@@ -1,9 +1,9 @@
 #ifndef CONSTANT_MEDIUM_H
 #define CONSTANT_MEDIUM_H
 
-#include "NextWeek/global.h"
-#include "NextWeek/interval.h"
-#include "NextWeek/vec3.h"
+#include "global.h"
+#include "interval.h"
+#include "vec3.h"
 #include "hittable.h"
 #include "material.h"
 #include "texture.h"
@@ -11,17 +11,55 @@
 class constant_medium : public hittable
 {
   public:
-    constant_medium(shared_ptr<hittable> boundary, double density, shared_ptr<texture> tex)
+    constant_medium(shared_ptr<hittable> boundary, real density, shared_ptr<texture> tex)
         : boundary(boundary), neg_inv_density(-1.0 / density), phase_function(make_shared<isotropic>(tex))
     {
     }
 
-    constant_medium(shared_ptr<hittable> boundary, double density, const color &albedo)
+    constant_medium(shared_ptr<hittable> boundary, real density, const color &albedo)
         : boundary(boundary), neg_inv_density(-1.0 / density), phase_function(make_shared<isotropic>(albedo))
     {
     }
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        real t;
+        if (!sample_distance(r, ray_t, t))
+            return false;
+
+        rec.t = t;
+        rec.p = r.at(rec.t);
+
+        rec.normal = random_unit_vector(); // 随机生成法向量
+        rec.outward = true;                // 随机设定
+        rec.mat = phase_function.get();
+        rec.object = nullptr;
+        rec.pending = nullptr;
+
+        return true;
+    }
+
+    // 散射点的分布与hit相同，但不生成随机法向量
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        real t;
+        return sample_distance(r, ray_t, t);
+    }
+
+    aabb bounding_box() const override
+    {
+        return boundary->bounding_box();
+    }
+
+  private:
+    shared_ptr<hittable> boundary;
+    real neg_inv_density;
+    shared_ptr<material> phase_function;
+
+    /**
+     * @brief 随机采样光线在介质中发生散射的位置t，光线在ray_t内穿过介质而未散射时返回false
+     */
+    bool sample_distance(const ray &r, interval ray_t, real &t) const
     {
         hit_record rec1, rec2;
 
@@ -45,35 +83,19 @@ class constant_medium : public hittable
             rec1.t = 0;
 
         // 计算传播距离
-        double ray_length = r.direction().length();
-        double distance_insid_medium = (rec2.t - rec1.t) * ray_length;
+        real ray_length = r.direction().length();
+        real distance_insid_medium = (rec2.t - rec1.t) * ray_length;
 
         // 随机生成光线和物体相交所需的传播距离
-        double hit_distance = neg_inv_density * std::log(random_double());
+        real hit_distance = neg_inv_density * std::log(random_double());
 
         // 光线穿过物体，没有相交
         if (hit_distance > distance_insid_medium)
             return false;
 
-        rec.t = rec1.t + hit_distance / ray_length;
-        rec.p = r.at(rec.t);
-
-        rec.normal = random_unit_vector(); // 随机生成法向量
-        rec.outward = true;                // 随机设定
-        rec.mat = phase_function;
-
+        t = rec1.t + hit_distance / ray_length;
         return true;
     }
-
-    aabb bounding_box() const override
-    {
-        return boundary->bounding_box();
-    }
-
-  private:
-    shared_ptr<hittable> boundary;
-    double neg_inv_density;
-    shared_ptr<material> phase_function;
 };
 
 #endif // !CONSTANT_MEDIUM_H
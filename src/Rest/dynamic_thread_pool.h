@@ -2,65 +2,105 @@
 #ifndef DYNAMICTHREADPOOL_HPP
 #define DYNAMICTHREADPOOL_HPP
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
 #include <thread>
+#include <vector>
 
 // 线程池类
+// 每个工作线程拥有自己的任务双端队列：线程从自己队列的尾部取任务（后进先出，缓存友好），
+// 自己的队列为空时从其他线程队列的头部窃取任务（先进先出，窃取较早、通常较大的任务）
 class DynamicThreadPool
 {
   public:
-    // 构造函数，传入线程数
+    // 构造函数，传入线程数，工作线程在构造时全部启动，析构时join
     DynamicThreadPool(size_t threads = 0);
     // 析构
     ~DynamicThreadPool();
 
-    // 入队任务(传入函数和函数的参数)
-    // template <class F, class... Args>
-    // auto enqueue(F &&f, Args &&...args) -> std::future<typename std::result_of<F(Args...)>::type>;
-    // 一个最简单的函数包装模板可以这样写(C++11)适用于任何函数(变参、成员都可以)
-    // template<class F, class... Args>
-    // auto enqueue(F&& f, Args&&... args) -> decltype(declval<F>()(declval<Args>()...))
-    // {    return f(args...); }
+    // 入队任务(传入函数和函数的参数)，返回任务的future
     // C++14更简单
     template <class F, class... Args> auto enqueue(F &&f, Args &&...args);
-    // {    return f(args...); }
 
-    // 停止线程池
+    // 入队不需要返回值的任务，不创建packaged_task和future，配合wait()使用
+    // 任务不应抛出异常
+    template <class F> void submit(F &&f);
+
+    // 等待所有已入队的任务执行完毕，只能在线程池外部调用
+    void wait();
+
+    // 停止线程池，已入队的任务执行完毕后所有工作线程退出
     void stopAll();
 
+    size_t size() const
+    {
+        return workers.size();
+    }
+
   private:
-    void newThread();
+    struct WorkQueue
+    {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void push(std::function<void()> task);
+    bool take(size_t index, std::function<void()> &task);
+    void run(std::function<void()> &task);
+    void worker_loop(size_t index);
 
   private:
-    std::atomic_int run_workers; // 当前运行的工作线程数
-    int max_workers;             // 最大工作线程数
-    // 任务队列
-    std::queue<std::function<void()>> tasks;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // 每个工作线程的任务队列
+    std::vector<std::thread> workers;               // 工作线程
+
+    std::atomic<size_t> pending;    // 已入队但还未被取走的任务数
+    std::atomic<size_t> unfinished; // 已入队但还未执行完的任务数
+    std::atomic<size_t> next_queue; // 外部线程入队时轮流选择队列
+    std::atomic<int> sleepers;      // 正在休眠的工作线程数
 
     // synchronization 异步
-    std::mutex queue_mutex;            // 队列互斥锁
-    std::condition_variable condition; // 条件变量
-    bool stop;                         // 停止标志
+    std::mutex sleep_mutex;            // 空闲线程休眠用的互斥锁
+    std::condition_variable sleep_cv;  // 有新任务或停止时唤醒空闲线程
+    std::mutex done_mutex;             // 等待任务全部完成用的互斥锁
+    std::condition_variable done_cv;   // 任务全部完成时唤醒等待者
+    std::atomic<bool> stop;            // 停止标志
+
+    // 当前线程所属的线程池及其队列下标，外部线程为nullptr
+    inline static thread_local DynamicThreadPool *current_pool = nullptr;
+    inline static thread_local size_t current_index = 0;
 };
 
-// 构造函数仅启动一些工作线程
-inline DynamicThreadPool::DynamicThreadPool(size_t threads) : run_workers(0), max_workers(threads), stop(false)
+// 构造函数启动所有工作线程
+inline DynamicThreadPool::DynamicThreadPool(size_t threads)
+    : pending(0), unfinished(0), next_queue(0), sleepers(0), stop(false)
 {
-    if (max_workers == 0 || max_workers > (int)std::thread::hardware_concurrency())
+    size_t max_workers = threads;
+    if (max_workers == 0 || max_workers > std::thread::hardware_concurrency())
     {
         max_workers = std::thread::hardware_concurrency();
     }
+    if (max_workers == 0)
+    {
+        max_workers = 1;
+    }
+
+    for (size_t i = 0; i < max_workers; ++i)
+    {
+        queues.emplace_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < max_workers; ++i)
+    {
+        workers.emplace_back([this, i]() { worker_loop(i); });
+    }
 }
 
 // 添加一个新的工作任务到线程池
-// template <class F, class... Args>
-// auto DynamicThreadPool::enqueue(F &&f, Args &&...args) -> std::future<typename std::result_of<F(Args...)>::type>
 template <class F, class... Args> auto DynamicThreadPool::enqueue(F &&f, Args &&...args)
 {
     using return_type = typename std::result_of<F(Args...)>::type;
@@ -71,28 +111,126 @@ template <class F, class... Args> auto DynamicThreadPool::enqueue(F &&f, Args &&
     // 获取任务的future
     std::future<return_type> res = task->get_future();
 
-    size_t tasks_size = 0;
+    push([task]() { (*task)(); });
+    return res;
+}
+
+template <class F> void DynamicThreadPool::submit(F &&f)
+{
+    push(std::function<void()>(std::forward<F>(f)));
+}
+
+inline void DynamicThreadPool::push(std::function<void()> task)
+{
+    // don't allow enqueueing after stopping the pool
+    // 不允许入队到已经停止的线程池
+    if (stop)
     {
-        std::lock_guard<std::mutex> lock(queue_mutex);
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
 
-        // don't allow enqueueing after stopping the pool
-        // 不允许入队到已经停止的线程池
-        if (stop)
+    // 工作线程入队到自己的队列，外部线程轮流入队到各个队列
+    size_t index = current_pool == this ? current_index : next_queue++ % queues.size();
+
+    // 先增加计数再入队，保证计数不会小于队列中的任务数
+    ++unfinished;
+    ++pending;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mtx);
+        queues[index]->tasks.emplace_back(std::move(task));
+    }
+
+    // 只有存在休眠线程时才需要拿锁唤醒，加锁保证休眠线程不会错过通知
+    if (sleepers > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_one();
+    }
+}
+
+inline bool DynamicThreadPool::take(size_t index, std::function<void()> &task)
+{
+    // 先从自己队列的尾部取
+    {
+        WorkQueue &own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --pending;
+            return true;
+        }
+    }
+
+    // 再从其他队列的头部窃取
+    for (size_t offset = 1; offset < queues.size(); ++offset)
+    {
+        WorkQueue &victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty())
         {
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --pending;
+            return true;
         }
-        // 将任务添加到任务队列
-        tasks.emplace([task]() { (*task)(); });
-        tasks_size = tasks.size();
     }
-    // 判断当前的任务积累数，如果任务积累太多，就再创建一个线程
-    if (run_workers < max_workers)
+
+    return false;
+}
+
+inline void DynamicThreadPool::run(std::function<void()> &task)
+{
+    task();
+    task = nullptr;
+
+    // 最后一个任务完成时唤醒wait()
+    if (--unfinished == 0)
     {
-        newThread(); // 创建新线程
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done_cv.notify_all();
     }
-    // 发送通知，唤醒某一个工作线程取执行任务
-    condition.notify_one();
-    return res;
+}
+
+inline void DynamicThreadPool::worker_loop(size_t index)
+{
+    current_pool = this;
+    current_index = index;
+
+    std::function<void()> task;
+    while (true)
+    {
+        if (take(index, task))
+        {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        ++sleepers;
+        // 使用条件变量等待新任务到来或停止信号
+        sleep_cv.wait(lock, [this] { return stop || pending > 0; });
+        --sleepers;
+
+        if (stop && pending == 0)
+        {
+            // 如果停止标志为真且没有剩余任务，退出线程
+            break;
+        }
+    }
+}
+
+inline void DynamicThreadPool::wait()
+{
+    // 任务内部等待时自身也计入未完成任务数，会永远等待
+    if (current_pool == this)
+    {
+        throw std::logic_error("wait on ThreadPool from its own worker");
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [this] { return unfinished == 0; });
 }
 
 inline DynamicThreadPool::~DynamicThreadPool()
@@ -104,52 +242,20 @@ inline void DynamicThreadPool::stopAll()
 {
     {
         // 拿锁
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        if (stop)
+            return;
         // 停止标志置true
         stop = true;
     }
-    // 通知所有工作线程，唤醒后因为stop为true了，所以都会结束
-    condition.notify_all();
+    // 通知所有工作线程，执行完剩余任务后结束
+    sleep_cv.notify_all();
     // 等待所有线程结束
-    while (run_workers > 0)
+    for (auto &worker : workers)
     {
-        // 如果工作线程是意外结束的，没有将 run_workers 减一，那么这里会陷入死循环
-        // 所以这里也可以修改为循环一定次数后就退出，不等了
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (worker.joinable())
+            worker.join();
     }
 }
 
-inline void DynamicThreadPool::newThread()
-{
-    ++run_workers; // 运行线程数加一
-
-    std::thread thr([this]() {
-        while (true)
-        {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(this->queue_mutex);
-
-                // 使用条件变量等待新任务到来或停止信号
-                this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-
-                if (this->stop && this->tasks.empty())
-                {
-                    // 如果停止标志为真且任务队列为空，退出线程
-                    break;
-                }
-
-                // 从任务队列取出一个任务
-                task = std::move(this->tasks.front());
-                this->tasks.pop();
-            }
-            // 执行任务
-            task();
-        }
-        --run_workers; // 运行线程数减一
-    });
-
-    thr.detach(); // 分离执行
-}
-
 #endif // DYNAMICTHREADPOOL_HPP
@@ -0,0 +1,188 @@
+#ifndef ENVIRONMENT_MAP_H
+#define ENVIRONMENT_MAP_H
+
+#include "color.h"
+#include "global.h"
+#include "rtw_stb_image.h"
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief 无穷远处的环境光，使用经纬度（equirectangular）格式的HDR图片，图片的最上方对应+y方向
+ *
+ * 方向与图片坐标的对应关系：s = phi / (2 * pi)，与sphere的纹理坐标u相同；t = theta / pi，theta为与+y的夹角。
+ * 按像素亮度乘以所在行的sin(theta)建立分段常数的二维分布，用于对环境光做重要性采样：
+ * 先按边缘分布选择行，再按该行的条件分布选择列，像素内均匀采样
+ */
+class environment_map
+{
+  public:
+    /**
+     * @param filename 图片文件，读取rtw_image的浮点数据（HDR图片为线性值，LDR图片由stb转换到线性空间）
+     * @param scale 辐射亮度的缩放系数
+     */
+    environment_map(const char *filename, real scale = 1) : image(filename), scale(scale)
+    {
+        width = image.width();
+        height = image.height();
+        build_distribution();
+    }
+
+    // 图片是否读取成功
+    bool valid() const
+    {
+        return width > 0 && height > 0;
+    }
+
+    // 是否可以重要性采样，整张图片都是黑色时不能采样
+    bool can_sample() const
+    {
+        return total > 0;
+    }
+
+    /**
+     * @brief 单位方向direction上的辐射亮度
+     */
+    color eval(const vec3 &direction) const
+    {
+        if (!valid())
+            return color(0, 0, 0);
+        int x, y;
+        pixel_of(direction, x, y);
+        return pixel(x, y);
+    }
+
+    /**
+     * @brief 按分布采样一个单位方向，pdf为立体角测度的概率密度
+     */
+    bool sample(vec3 &direction, real &pdf, color &radiance) const
+    {
+        if (!can_sample())
+            return false;
+
+        // 选择行，再选择该行中的列，随机数在所选区间内的位置作为像素内的偏移
+        double r1, r2;
+        random_double_2d(r1, r2);
+        int y = find_interval(marginal_cdf.data(), height, r1);
+        double dy = (r1 - marginal_cdf[y]) / (marginal_cdf[y + 1] - marginal_cdf[y]);
+
+        const double *row_cdf = &conditional_cdf[size_t(y) * (width + 1)];
+        int x = find_interval(row_cdf, width, r2);
+        double dx = (r2 - row_cdf[x]) / (row_cdf[x + 1] - row_cdf[x]);
+
+        real s = (x + dx) / width;
+        real t = (y + dy) / height;
+        real theta = t * pi;
+        real phi = s * 2 * pi;
+        real sin_theta = std::sin(theta);
+        if (sin_theta <= 0)
+            return false;
+        direction = vec3(-sin_theta * std::cos(phi), std::cos(theta), sin_theta * std::sin(phi));
+
+        pdf = pixel_pdf(x, y) / (2 * pi * pi * sin_theta);
+        if (pdf <= 0)
+            return false;
+        radiance = pixel(x, y);
+        return true;
+    }
+
+    /**
+     * @brief sample采样到单位方向direction的立体角概率密度
+     */
+    real pdf(const vec3 &direction) const
+    {
+        if (!can_sample())
+            return 0;
+        real sin_theta = std::sqrt(std::fmax(0, 1 - direction.y() * direction.y()));
+        if (sin_theta <= 0)
+            return 0;
+        int x, y;
+        pixel_of(direction, x, y);
+        return pixel_pdf(x, y) / (2 * pi * pi * sin_theta);
+    }
+
+  private:
+    rtw_image image;
+    real scale;
+    int width = 0, height = 0;
+    // 每个像素的采样权重（亮度 * sin(theta)）
+    std::vector<double> weights;
+    // 每一行的条件分布，每行width + 1个值
+    std::vector<double> conditional_cdf;
+    // 行的边缘分布，共height + 1个值
+    std::vector<double> marginal_cdf;
+    // 所有像素权重的平均值，图片坐标[0, 1]^2上的概率密度为权重除以该值
+    double total = 0;
+
+    color pixel(int x, int y) const
+    {
+        const float *p = image.float_pixel_data(x, y);
+        return scale * color(p[0], p[1], p[2]);
+    }
+
+    void pixel_of(const vec3 &direction, int &x, int &y) const
+    {
+        real t = std::acos(std::clamp(direction.y(), real(-1), real(1))) / pi;
+        real s = (std::atan2(-direction.z(), direction.x()) + pi) / (2 * pi);
+        x = std::clamp(int(s * width), 0, width - 1);
+        y = std::clamp(int(t * height), 0, height - 1);
+    }
+
+    // 像素(x, y)在图片坐标上的概率密度
+    real pixel_pdf(int x, int y) const
+    {
+        return real(weights[size_t(y) * width + x] / total);
+    }
+
+    // 返回满足cdf[i] <= u < cdf[i + 1]且区间长度不为0的i
+    static int find_interval(const double *cdf, int n, double u)
+    {
+        int i = int(std::upper_bound(cdf, cdf + n + 1, u) - cdf) - 1;
+        i = std::clamp(i, 0, n - 1);
+        // 舍入误差使u不小于最后一个值时，退回到最后一个长度不为0的区间
+        while (i > 0 && cdf[i + 1] <= cdf[i])
+            --i;
+        return i;
+    }
+
+    void build_distribution()
+    {
+        if (!valid())
+            return;
+
+        weights.resize(size_t(width) * height);
+        conditional_cdf.resize(size_t(height) * (width + 1));
+        marginal_cdf.resize(height + 1);
+
+        marginal_cdf[0] = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            double sin_theta = std::sin(pi * (y + 0.5) / height);
+            double *row_cdf = &conditional_cdf[size_t(y) * (width + 1)];
+            row_cdf[0] = 0;
+            for (int x = 0; x < width; ++x)
+            {
+                color c = pixel(x, y);
+                double luminance = 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+                double weight = std::fmax(luminance, 0) * sin_theta;
+                weights[size_t(y) * width + x] = weight;
+                row_cdf[x + 1] = row_cdf[x] + weight;
+            }
+            double row_sum = row_cdf[width];
+            for (int x = 1; x <= width; ++x)
+                row_cdf[x] = row_sum > 0 ? row_cdf[x] / row_sum : double(x) / width;
+            marginal_cdf[y + 1] = marginal_cdf[y] + row_sum;
+        }
+
+        double sum = marginal_cdf[height];
+        if (sum <= 0)
+            return;
+        for (int y = 1; y <= height; ++y)
+            marginal_cdf[y] /= sum;
+        total = sum / (double(width) * height);
+    }
+};
+
+#endif // !ENVIRONMENT_MAP_H
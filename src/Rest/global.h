@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
@@ -11,20 +12,32 @@
 #include <mutex>
 #include <random>
 
+#include "sampler.h"
+
 // C++ Std Usings
 
 using std::make_shared;
 using std::shared_ptr;
 
-// Initialize the thread-local RNG and distribution
-static thread_local std::mt19937 rng(std::random_device{}());
-static std::uniform_real_distribution<double> distribution(0.0, 1.0);
+// Scalar Type
+
+// 向量、区间、包围盒、光线等核心数学类型使用的浮点类型，定义RT_USE_FLOAT时使用单精度
+#ifdef RT_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
+const real infinity = std::numeric_limits<real>::infinity();
 const double pi = 3.1415926535897932385;
 
+// 光线求交的最小距离，避免交点的舍入误差导致散射光线与出发的表面再次相交，单精度的误差更大
+const real ray_t_min = sizeof(real) < sizeof(double) ? real(0.01) : real(0.001);
+// 平面法线与光线方向点积的绝对值小于该值时认为光线与平面平行
+const real parallel_epsilon = sizeof(real) < sizeof(double) ? real(1e-6) : real(1e-8);
+
 // Utility Functions
 
 inline double degrees_to_radians(double degree)
@@ -32,6 +45,182 @@ inline double degrees_to_radians(double degree)
     return degree * pi / 180.0;
 }
 
+// Random Number Generators
+
+/**
+ * @brief splitmix64，用于由一个种子生成其他生成器的初始状态，也可作为哈希函数
+ */
+inline uint64_t splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief xoshiro256+，生成浮点数时速度很快，低位质量较差但转换为double时只用高53位
+ */
+class xoshiro256plus
+{
+  public:
+    explicit xoshiro256plus(uint64_t seed = 0)
+    {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed)
+    {
+        for (auto &word : s)
+            word = splitmix64(seed);
+    }
+
+    uint64_t next()
+    {
+        const uint64_t result = s[0] + s[3];
+        const uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+
+        return result;
+    }
+
+    // [0, 1)之间的随机数
+    double next_double()
+    {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+  private:
+    uint64_t s[4];
+};
+
+/**
+ * @brief PCG32（XSH RR），状态更小，32位输出
+ */
+class pcg32
+{
+  public:
+    explicit pcg32(uint64_t seed = 0)
+    {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed)
+    {
+        inc = (splitmix64(seed) << 1) | 1u;
+        state = 0;
+        next_u32();
+        state += splitmix64(seed);
+        next_u32();
+    }
+
+    uint32_t next_u32()
+    {
+        uint64_t old_state = state;
+        state = old_state * 6364136223846793005ull + inc;
+        uint32_t xorshifted = uint32_t(((old_state >> 18u) ^ old_state) >> 27u);
+        uint32_t rot = uint32_t(old_state >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    // [0, 1)之间的随机数，精度为32位
+    double next_double()
+    {
+        return next_u32() * 0x1.0p-32;
+    }
+
+  private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// 编译时选择随机数生成器，定义RT_RNG_PCG32时使用PCG32
+#ifdef RT_RNG_PCG32
+using rt_rng = pcg32;
+#else
+using rt_rng = xoshiro256plus;
+#endif
+
+// 每个线程独立的随机数生成器，默认使用random_device初始化
+inline thread_local rt_rng rng(std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32));
+
+// 当前线程正在进行的采样使用的低差异序列，未激活时随机数来自rng
+inline thread_local sobol_sequence sample_sequence;
+
+/**
+ * @brief 重新设置当前线程随机数生成器的种子，用于生成可复现的场景
+ */
+inline void seed_random(uint64_t seed)
+{
+    rng.seed(seed);
+    sample_sequence.stop();
+}
+
+/**
+ * @brief 根据(像素, 采样)重新设置当前线程的随机数生成器
+ * 同一个采样内依次取出的随机数即各个维度，因此结果只取决于种子、像素和采样编号，与线程数和渲染顺序无关
+ *
+ * @param seed 全局种子
+ * @param pixel 像素编号
+ * @param sample 像素内的采样编号
+ */
+inline void seed_random_sample(uint64_t seed, uint64_t pixel, uint64_t sample)
+{
+    uint64_t key = seed;
+    key = splitmix64(key) ^ pixel;
+    key = splitmix64(key) ^ sample;
+    rng.seed(splitmix64(key));
+}
+
+/**
+ * @brief 像素的第sample个采样改为从Owen扰乱的Sobol序列中依次取各个维度，直到调用stop_sobol_sample或seed_random
+ *
+ * @param seed 全局种子
+ * @param pixel 像素编号
+ * @param sample 像素内的采样编号
+ */
+inline void start_sobol_sample(uint64_t seed, uint64_t pixel, uint64_t sample)
+{
+    uint64_t key = seed ^ 0x5851f42d4c957f2dull;
+    key = splitmix64(key) ^ pixel;
+    sample_sequence.start(splitmix64(key), uint32_t(sample));
+}
+
+inline void stop_sobol_sample()
+{
+    sample_sequence.stop();
+}
+
+// 是否正在使用低差异序列，此时拒绝采样等消耗维度数量不固定的方法应改为固定维度的映射
+inline bool sobol_sample_active()
+{
+    return sample_sequence.active();
+}
+
+// 当前线程的随机数状态，用于在交错追踪多条路径时保存和恢复每条路径自己的随机数
+struct random_state
+{
+    rt_rng generator;
+    sobol_sequence sequence;
+};
+
+inline random_state save_random_state()
+{
+    return {rng, sample_sequence};
+}
+
+inline void restore_random_state(const random_state &state)
+{
+    rng = state.generator;
+    sample_sequence = state.sequence;
+}
+
 /**
  * @brief 返回[0, 1)之间的随机数
  *
@@ -39,8 +228,24 @@ inline double degrees_to_radians(double degree)
  */
 inline double random_double()
 {
-    return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
-    // return rand_r(NULL) / (RAND_MAX + 1.0);
+    if (sample_sequence.active())
+        return sample_sequence.next_1d();
+    return rng.next_double();
+}
+
+/**
+ * @brief 返回两个[0, 1)之间的随机数，作为一个二维采样（如像素内的位置、方向）
+ * 使用低差异序列时两个值来自同一组二维点，分层性质更好
+ */
+inline void random_double_2d(double &u, double &v)
+{
+    if (sample_sequence.active())
+    {
+        sample_sequence.next_2d(u, v);
+        return;
+    }
+    u = rng.next_double();
+    v = rng.next_double();
 }
 
 inline double random_double(double min, double max)
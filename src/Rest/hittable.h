@@ -2,26 +2,43 @@
 #define HITTABLE_H
 
 #include "aabb.h"
+#include "color.h"
 #include "global.h"
 #include "interval.h"
 #include "ray.h"
 #include "vec3.h"
 #include <cmath>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 class material;
+class hittable;
 
 class hit_record
 {
   public:
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat;
-    double t;
+    // 材质由场景中的物体持有，这里只记录非拥有的指针，避免每次相交时原子地修改引用计数
+    const material *mat = nullptr;
+    // 命中的图元，可以作为光源采样的sphere和quad记录自身，其他为nullptr，用于多重重要性采样时计算光源采样的pdf
+    const hittable *object = nullptr;
+    real t;
     // ture表示光线来自外部，false表示来自内部
     bool outward;
-    // 纹理坐标
-    double u, v;
+    // 纹理坐标，属性计算之前为图元的参数坐标（如三角形的重心坐标）
+    real u, v;
+    // 延迟计算属性的图元：求交时只记录t、primitive和参数坐标，最近的交点确定后由finish计算p、法向量、纹理坐标和材质
+    // 立即计算属性的物体需要将其置为nullptr，避免沿用之前较远交点的图元
+    const hittable *pending = nullptr;
+    // 图元内部的编号，如网格中三角形的下标
+    int primitive = 0;
+
+    /**
+     * @brief 最近交点确定后计算交点的属性，r为求交时使用的光线
+     */
+    void finish(const ray &r);
 
     /**
      * @brief 设置交点法向量始终朝外
@@ -36,6 +53,18 @@ class hit_record
     }
 };
 
+// 在光源表面采样得到的一点，或者环境光的一个方向
+struct light_sample
+{
+    point3 p;
+    real pdf;                      // 从采样的起点看，该点对应方向的立体角概率密度
+    real u, v;                     // 纹理坐标
+    const material *mat = nullptr; // 光源的材质
+    bool infinite = false;         // 为true时采样的是无穷远处的环境光，此时p、u、v、mat无效
+    vec3 direction;                // 环境光的单位方向
+    color radiance;                // 环境光在该方向上的辐射亮度
+};
+
 class hittable
 {
   public:
@@ -43,9 +72,83 @@ class hittable
 
     virtual bool hit(const ray &r, interval ray_t, hit_record &rec) const = 0;
 
+    /**
+     * @brief 同时与一组光线求交，第k条光线的有效区间为(t_min, t_max[k])
+     * 第k条光线找到更近的交点时更新t_max[k]和recs[k]，并将hit_mask的第k位置1
+     * 默认逐条光线调用hit，加速结构可以重写该函数成组遍历
+     *
+     * @param rays 光线数组
+     * @param count 光线数量，不超过max_packet_size
+     */
+    virtual void hit_packet(const ray *rays, int count, real t_min, real *t_max, hit_record *recs,
+                            uint32_t &hit_mask) const
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            if (hit(rays[k], interval(t_min, t_max[k]), recs[k]))
+            {
+                t_max[k] = recs[k].t;
+                hit_mask |= 1u << k;
+            }
+        }
+    }
+
+    /**
+     * @brief 判断区间(ray_t.min, ray_t.max)内是否存在任意交点，用于阴影光线等可见性查询
+     * 找到一个交点即可返回，不需要最近的交点，也不计算法向量、纹理坐标等属性
+     * 默认调用hit，图元和加速结构应重写为更快的版本
+     */
+    virtual bool occluded(const ray &r, interval ray_t) const
+    {
+        hit_record rec;
+        return hit(r, ray_t, rec);
+    }
+
+    /**
+     * @brief 根据hit记录的t、primitive和参数坐标计算交点的p、法向量、纹理坐标和材质
+     * 只由hit_record::finish调用，hit中把rec.pending设为自身的图元需要重写
+     */
+    virtual void finish_hit(const ray &r, hit_record &rec) const
+    {
+    }
+
     virtual aabb bounding_box() const = 0;
+
+    /**
+     * @brief 将可以直接采样的光源图元加入lights，容器类递归地收集其中的物体
+     */
+    virtual void collect_lights(std::vector<const hittable *> &lights) const
+    {
+    }
+
+    /**
+     * @brief 从origin看向该图元，在其表面上采样一点，采样失败时返回false
+     */
+    virtual bool sample_light(const point3 &origin, light_sample &sample) const
+    {
+        return false;
+    }
+
+    /**
+     * @brief 从origin出发的光线命中该图元的rec时，sample_light采样到该方向的立体角概率密度
+     */
+    virtual real light_pdf(const point3 &origin, const hit_record &rec) const
+    {
+        return 0;
+    }
+
+    static constexpr int max_packet_size = 16;
 };
 
+inline void hit_record::finish(const ray &r)
+{
+    if (!pending)
+        return;
+    const hittable *object = pending;
+    pending = nullptr;
+    object->finish_hit(r, *this);
+}
+
 class translate : public hittable
 {
   public:
@@ -61,11 +164,20 @@ class translate : public hittable
         if (!object->hit(offset_r, ray_t, rec))
             return false;
 
+        // 交点需要在物体坐标中计算属性后再变换
+        rec.finish(offset_r);
         rec.p += offset;
+        // 交点已变换到世界坐标，不能再由图元计算光源采样的pdf
+        rec.object = nullptr;
 
         return true;
     }
 
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        return object->occluded(ray(r.origin() - offset, r.direction(), r.time()), ray_t);
+    }
+
     aabb bounding_box() const override
     {
         return bbox;
@@ -80,9 +192,9 @@ class translate : public hittable
 class rotate_y : public hittable
 {
   public:
-    rotate_y(shared_ptr<hittable> object, double angle) : object(object)
+    rotate_y(shared_ptr<hittable> object, real angle) : object(object)
     {
-        double radians = degrees_to_radians(angle);
+        real radians = degrees_to_radians(angle);
         sin_theta = std::sin(radians);
         cos_theta = std::cos(radians);
         bbox = object->bounding_box();
@@ -96,12 +208,12 @@ class rotate_y : public hittable
             {
                 for (int k = 0; k < 2; ++k)
                 {
-                    double x = i * bbox.x.max + (1 - i) * bbox.x.min;
-                    double y = j * bbox.y.max + (1 - j) * bbox.y.min;
-                    double z = k * bbox.z.max + (1 - k) * bbox.z.min;
+                    real x = i * bbox.x.max + (1 - i) * bbox.x.min;
+                    real y = j * bbox.y.max + (1 - j) * bbox.y.min;
+                    real z = k * bbox.z.max + (1 - k) * bbox.z.min;
 
-                    double new_x = x * cos_theta + z * sin_theta;
-                    double new_z = -x * sin_theta + z * cos_theta;
+                    real new_x = x * cos_theta + z * sin_theta;
+                    real new_z = -x * sin_theta + z * cos_theta;
 
                     point3 tmp(new_x, y, new_z);
 
@@ -119,18 +231,10 @@ class rotate_y : public hittable
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
-        // 将光线从世界坐标转换到物体坐标
-
-        point3 origin = point3((r.origin().x() * cos_theta - (r.origin().z() * sin_theta)), r.origin().y(),
-                               (r.origin().x() * sin_theta + r.origin().z() * cos_theta));
-
-        vec3 direction = vec3((r.direction().x() * cos_theta - (r.direction().z() * sin_theta)), r.direction().y(),
-                              (r.direction().x() * sin_theta + r.direction().z() * cos_theta));
-
-        ray rotate_r(origin, direction, r.time());
-
+        ray rotate_r = to_object(r);
         if (!object->hit(rotate_r, ray_t, rec))
             return false;
+        rec.finish(rotate_r);
 
         // 将交点从物体坐标转换为世界坐标
 
@@ -139,10 +243,16 @@ class rotate_y : public hittable
 
         rec.normal = vec3((rec.normal.x() * cos_theta + rec.normal.z() * sin_theta), rec.normal.y(),
                           (-rec.normal.x() * sin_theta + rec.normal.z() * cos_theta));
+        rec.object = nullptr;
 
         return true;
     }
 
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        return object->occluded(to_object(r), ray_t);
+    }
+
     aabb bounding_box() const override
     {
         return bbox;
@@ -150,8 +260,22 @@ class rotate_y : public hittable
 
   private:
     shared_ptr<hittable> object;
-    double sin_theta, cos_theta;
+    real sin_theta, cos_theta;
     aabb bbox;
+
+    /**
+     * @brief 将光线从世界坐标转换到物体坐标
+     */
+    ray to_object(const ray &r) const
+    {
+        point3 origin = point3((r.origin().x() * cos_theta - (r.origin().z() * sin_theta)), r.origin().y(),
+                               (r.origin().x() * sin_theta + r.origin().z() * cos_theta));
+
+        vec3 direction = vec3((r.direction().x() * cos_theta - (r.direction().z() * sin_theta)), r.direction().y(),
+                              (r.direction().x() * sin_theta + r.direction().z() * cos_theta));
+
+        return ray(origin, direction, r.time());
+    }
 };
 
 #endif // !HITTABLE_H
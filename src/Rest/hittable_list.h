@@ -1,7 +1,7 @@
 #ifndef HITTABLE_LIST_H
 #define HITTABLE_LIST_H
 
-#include "NextWeek/aabb.h"
+#include "aabb.h"
 #include "global.h"
 #include "hittable.h"
 #include "interval.h"
@@ -33,29 +33,53 @@ class hittable_list : public hittable
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
-        hit_record temp_rec;
         bool hit_anything = false;
-        double closet_so_far = ray_t.max;
+        real closet_so_far = ray_t.max;
 
         for (const auto &object : objects)
         {
-            // 只保留最近的hit记录
-            if (object->hit(r, interval(ray_t.min, closet_so_far), temp_rec))
+            // 只保留最近的hit记录，物体只在相交时写入rec，因此可以直接传入rec而不必拷贝
+            if (object->hit(r, interval(ray_t.min, closet_so_far), rec))
             {
                 hit_anything = true;
-                closet_so_far = temp_rec.t;
-                rec = temp_rec;
+                closet_so_far = rec.t;
             }
         }
 
         return hit_anything;
     }
 
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        for (const auto &object : objects)
+        {
+            if (object->occluded(r, ray_t))
+                return true;
+        }
+        return false;
+    }
+
+    void hit_packet(const ray *rays, int count, real t_min, real *t_max, hit_record *recs,
+                    uint32_t &hit_mask) const override
+    {
+        // t_max随每个物体的求交而缩小，后面的物体只需寻找更近的交点
+        for (const auto &object : objects)
+        {
+            object->hit_packet(rays, count, t_min, t_max, recs, hit_mask);
+        }
+    }
+
     aabb bounding_box() const override
     {
         return bbox;
     }
 
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        for (const auto &object : objects)
+            object->collect_lights(lights);
+    }
+
     int size() const
     {
         return objects.size();
@@ -0,0 +1,244 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "color.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 输出图片格式
+enum class image_format
+{
+    ppm_ascii, // P3文本格式
+    ppm,       // P6二进制格式
+    png,       // 未压缩的PNG
+    pfm,       // 线性空间的浮点图片
+};
+
+/**
+ * @brief 根据名称解析图片格式，无法识别时返回false
+ *
+ * @param name 格式名称：p3、ppm、png、pfm
+ * @param format 解析得到的格式
+ * @return 是否解析成功
+ */
+inline bool parse_image_format(const std::string &name, image_format &format)
+{
+    if (name == "p3")
+        format = image_format::ppm_ascii;
+    else if (name == "ppm" || name == "p6")
+        format = image_format::ppm;
+    else if (name == "png")
+        format = image_format::png;
+    else if (name == "pfm")
+        format = image_format::pfm;
+    else
+        return false;
+    return true;
+}
+
+// 图片格式对应的文件扩展名
+inline const char *image_format_extension(image_format format)
+{
+    switch (format)
+    {
+    case image_format::png:
+        return "png";
+    case image_format::pfm:
+        return "pfm";
+    default:
+        return "ppm";
+    }
+}
+
+/**
+ * @brief 对整个framebuffer做gamma校正和截断，转换为[0, 255]的字节，按rgb顺序存储
+ *
+ * @param framebuffer 线性空间的颜色
+ * @param bytes 输出的字节
+ */
+inline void framebuffer_to_bytes(const std::vector<color> &framebuffer, std::vector<unsigned char> &bytes)
+{
+    // color内部是连续的real数组（SIMD版本每个颜色后有一个填充分量），按像素和分量展开成简单的循环，方便编译器向量化
+    constexpr size_t stride = sizeof(color) / sizeof(real);
+    static_assert(sizeof(color) == stride * sizeof(real) && stride >= 3, "color should be packed reals");
+    const real *src = framebuffer.empty() ? nullptr : framebuffer[0].e;
+    bytes.resize(framebuffer.size() * 3);
+
+    for (size_t p = 0; p < framebuffer.size(); ++p)
+    {
+        for (size_t c = 0; c < 3; ++c)
+        {
+            // 与write_color一致：gamma为2，将[0, 1]转换为[0, 255]，负数和NaN都输出0
+            double value = src[p * stride + c];
+            value = value > 0 ? std::sqrt(value) : 0;
+            value = std::min(value, 0.999);
+            bytes[p * 3 + c] = static_cast<unsigned char>(256 * value);
+        }
+    }
+}
+
+namespace image_writer_detail
+{
+
+inline void put_u32_be(std::vector<unsigned char> &out, uint32_t value)
+{
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+inline uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc = 0)
+{
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void put_chunk(std::vector<unsigned char> &out, const char type[4], const std::vector<unsigned char> &data)
+{
+    put_u32_be(out, static_cast<uint32_t>(data.size()));
+    size_t crc_start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32_be(out, crc32(out.data() + crc_start, out.size() - crc_start));
+}
+
+/**
+ * @brief 编码PNG，图像数据使用deflate的stored块，不依赖zlib
+ */
+inline void encode_png(int width, int height, const std::vector<unsigned char> &rgb, std::vector<unsigned char> &out)
+{
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<unsigned char> header;
+    put_u32_be(header, width);
+    put_u32_be(header, height);
+    // 8位深度，rgb，默认压缩、滤波方式，不交错
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    put_chunk(out, "IHDR", header);
+
+    // 每一行前加上滤波类型0
+    size_t row_bytes = size_t(width) * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int j = 0; j < height; ++j)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + j * row_bytes, rgb.begin() + (j + 1) * row_bytes);
+    }
+
+    // zlib流：头部、stored块、adler32校验
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t pos = 0;
+    do
+    {
+        size_t block = std::min<size_t>(raw.size() - pos, 65535);
+        bool final_block = pos + block == raw.size();
+        zlib.push_back(final_block ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(block & 0xff));
+        zlib.push_back(static_cast<unsigned char>(block >> 8));
+        zlib.push_back(static_cast<unsigned char>(~block & 0xff));
+        zlib.push_back(static_cast<unsigned char>((~block >> 8) & 0xff));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + block);
+        pos += block;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32_be(zlib, (b << 16) | a);
+    put_chunk(out, "IDAT", zlib);
+
+    put_chunk(out, "IEND", {});
+}
+
+} // namespace image_writer_detail
+
+/**
+ * @brief 将framebuffer编码为指定格式，一次性写入输出流
+ *
+ * @param out 输出流
+ * @param format 图片格式
+ * @param width 图片宽度
+ * @param height 图片高度
+ * @param framebuffer 线性空间的颜色，按行从上到下存储
+ */
+inline void write_image(std::ostream &out, image_format format, int width, int height,
+                        const std::vector<color> &framebuffer)
+{
+    std::vector<unsigned char> bytes;
+    std::string header;
+    std::vector<unsigned char> encoded;
+
+    switch (format)
+    {
+    case image_format::ppm_ascii: {
+        framebuffer_to_bytes(framebuffer, bytes);
+        std::string text = "P3\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        text.reserve(text.size() + bytes.size() * 4);
+        for (size_t i = 0; i < bytes.size(); i += 3)
+        {
+            text += std::to_string(bytes[i]) + " " + std::to_string(bytes[i + 1]) + " " +
+                    std::to_string(bytes[i + 2]) + "\n";
+        }
+        out.write(text.data(), text.size());
+        break;
+    }
+    case image_format::ppm:
+        framebuffer_to_bytes(framebuffer, bytes);
+        header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        out.write(header.data(), header.size());
+        out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        break;
+    case image_format::png:
+        framebuffer_to_bytes(framebuffer, bytes);
+        image_writer_detail::encode_png(width, height, bytes, encoded);
+        out.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+        break;
+    case image_format::pfm: {
+        // PFM不做gamma校正，scale为负表示小端序，按行从下到上存储
+        header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+        std::vector<float> data(framebuffer.size() * 3);
+        for (int j = 0; j < height; ++j)
+        {
+            const color *row = &framebuffer[size_t(height - 1 - j) * width];
+            float *dst = &data[size_t(j) * width * 3];
+            for (int i = 0; i < width * 3; ++i)
+                dst[i] = static_cast<float>(row[i / 3][i % 3]);
+        }
+        out.write(header.data(), header.size());
+        out.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(float));
+        break;
+    }
+    }
+
+    out.flush();
+}
+
+#endif // !IMAGE_WRITER_H
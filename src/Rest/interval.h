@@ -1,20 +1,20 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
 
-#include "NextWeek/vec3.h"
+#include "vec3.h"
 #include "global.h"
 
 class interval
 {
   public:
-    double min, max;
+    real min, max;
 
     // 默认是空区间
     interval() : min(+infinity), max(-infinity)
     {
     }
 
-    interval(double min, double max) : min(min), max(max)
+    interval(real min, real max) : min(min), max(max)
     {
     }
 
@@ -24,22 +24,22 @@ class interval
         max = a.max >= b.max ? a.max : b.max;
     }
 
-    double size() const
+    real size() const
     {
         return max - min;
     }
 
-    bool contains(double x) const
+    bool contains(real x) const
     {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const
+    bool surrounds(real x) const
     {
         return min < x && x < max;
     }
 
-    double clamp(double x) const
+    real clamp(real x) const
     {
         if (x < min)
             return min;
@@ -48,9 +48,9 @@ class interval
         return x;
     }
 
-    interval expand(double delta) const
+    interval expand(real delta) const
     {
-        double padding = delta / 2;
+        real padding = delta / 2;
         return interval(min - padding, max + padding);
     }
 
@@ -60,12 +60,12 @@ class interval
 inline const interval interval::empty = interval(+infinity, -infinity);
 inline const interval interval::universe = interval(-infinity, +infinity);
 
-inline interval operator+(const interval &in, double displacement)
+inline interval operator+(const interval &in, real displacement)
 {
     return interval(in.min + displacement, in.max + displacement);
 }
 
-inline interval operator+(double displacement, const interval &in)
+inline interval operator+(real displacement, const interval &in)
 {
     return in + displacement;
 }
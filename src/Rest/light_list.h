@@ -0,0 +1,103 @@
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include "environment_map.h"
+#include "global.h"
+#include "hittable.h"
+#include "vec3.h"
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief 场景中可以直接采样的光源（发光的quad和静止的sphere）以及环境光，用于直接光照采样
+ * 每次均匀地选择一个光源，再在光源表面上或环境光的方向分布中采样
+ */
+class light_list
+{
+  public:
+    /**
+     * @brief 从场景中收集光源，收集顺序由场景结构决定，重复的图元只保留一次
+     *
+     * @param environment 环境光，为空或者不能采样时只采样场景中的光源
+     */
+    void build(const hittable &world, const environment_map *environment = nullptr)
+    {
+        clear();
+        if (environment && environment->can_sample())
+            this->environment = environment;
+        std::vector<const hittable *> collected;
+        world.collect_lights(collected);
+        for (const hittable *light : collected)
+        {
+            if (members.insert(light).second)
+                lights.push_back(light);
+        }
+    }
+
+    void clear()
+    {
+        lights.clear();
+        members.clear();
+        environment = nullptr;
+    }
+
+    bool empty() const
+    {
+        return lights.empty() && !environment;
+    }
+
+    // 光源数量，环境光算作最后一个光源
+    size_t size() const
+    {
+        return lights.size() + (environment ? 1 : 0);
+    }
+
+    /**
+     * @brief 均匀选择一个光源并在其表面采样一点，sample.pdf包含选择光源的概率
+     */
+    bool sample(const point3 &origin, light_sample &sample) const
+    {
+        size_t count = size();
+        size_t index = std::min(size_t(random_double() * count), count - 1);
+        if (index == lights.size())
+        {
+            if (!environment->sample(sample.direction, sample.pdf, sample.radiance))
+                return false;
+            sample.infinite = true;
+        }
+        else if (!lights[index]->sample_light(origin, sample))
+        {
+            return false;
+        }
+        sample.pdf /= real(count);
+        return true;
+    }
+
+    /**
+     * @brief 从origin出发的光线命中rec时，由sample采样到该方向的概率密度，命中的不是光源时为0
+     */
+    real pdf(const point3 &origin, const hit_record &rec) const
+    {
+        if (!rec.object || members.count(rec.object) == 0)
+            return 0;
+        return rec.object->light_pdf(origin, rec) / real(size());
+    }
+
+    /**
+     * @brief 没有击中任何物体的光线沿单位方向direction到达环境光时，由sample采样到该方向的概率密度
+     */
+    real environment_pdf(const vec3 &direction) const
+    {
+        if (!environment)
+            return 0;
+        return environment->pdf(direction) / real(size());
+    }
+
+  private:
+    std::vector<const hittable *> lights;
+    std::unordered_set<const hittable *> members;
+    const environment_map *environment = nullptr;
+};
+
+#endif // !LIGHT_LIST_H
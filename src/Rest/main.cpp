@@ -1,68 +1,234 @@
+#include "bvh4.h"
 #include "camera.h"
 #include "color.h"
 #include "global.h"
 #include "hittable_list.h"
+#include "image_writer.h"
 #include "material.h"
 #include "quad.h"
+#include "scene_loader.h"
+#include "scenes.h"
 #include "vec3.h"
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
 
-void cornell_box()
+// 命令行指定的渲染选项
+struct render_options
 {
-    hittable_list world;
-
-    auto red = make_shared<lambertian>(color(.65, .05, .05));
-    auto white = make_shared<lambertian>(color(.73, .73, .73));
-    auto green = make_shared<lambertian>(color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(color(15, 15, 15));
+    image_format format = image_format::ppm;
+    int samples_per_pass = 0; // 大于0时使用渐进式渲染
+    double time_limit = 0;    // 渐进式渲染的时间上限（秒）
+    std::string progress_file; // 渐进式渲染的中间结果文件，为空时由场景名得到
+    double adaptive_threshold = 0; // 大于0时使用自适应采样
+    int adaptive_min_samples = 0;  // 以下两个参数大于0时覆盖自适应采样每个像素的最少、最多采样数
+    int adaptive_max_samples = 0;
+    bool deterministic = false;    // 指定种子后渲染结果可复现
+    uint64_t seed = 0;
+    bool packet_tracing = false;   // 主光线按像素块成组求交
+    bool wavefront = false;        // 波前式路径追踪
+    bool light_sampling = true;    // 对光源直接采样
+    sampler_type sampler = sampler_type::independent; // 采样器
+    std::string scene_file;        // 场景描述文件，为空时使用内置的场景
+    std::string scene_name = "cornell_box"; // 内置场景
+    int image_width = 0;           // 以下参数大于0时覆盖场景中的相机设置
+    int samples_per_pixel = 0;
+    int max_depth = 0;
+    std::string cache_dir;         // 网格缓存目录
+};
 
-    // Cornell box sides
-    world.add(make_shared<quad>(point3(555, 0, 0), vec3(0, 0, 555), vec3(0, 555, 0), green));
-    world.add(make_shared<quad>(point3(0, 0, 555), vec3(0, 0, -555), vec3(0, 555, 0), red));
-    world.add(make_shared<quad>(point3(0, 555, 0), vec3(555, 0, 0), vec3(0, 0, 555), white));
-    world.add(make_shared<quad>(point3(0, 0, 555), vec3(555, 0, 0), vec3(0, 0, -555), white));
-    world.add(make_shared<quad>(point3(555, 0, 555), vec3(-555, 0, 0), vec3(0, 555, 0), white));
-
-    // Light
-    world.add(make_shared<quad>(point3(213, 554, 227), vec3(130, 0, 0), vec3(0, 0, 105), light));
+/**
+ * @brief 默认的中间结果文件：<场景名>.progress.<扩展名>，场景名为场景文件去掉目录和扩展名，或内置场景名，
+ * 在同一目录中渲染不同的场景时不会互相覆盖，同时渲染同一场景时需要用-o指定不同的文件
+ */
+std::string default_progress_file(const render_options &options)
+{
+    std::string name = options.scene_name;
+    if (!options.scene_file.empty())
+    {
+        name = options.scene_file.substr(options.scene_file.find_last_of('/') + 1);
+        size_t dot = name.find_last_of('.');
+        if (dot != std::string::npos && dot > 0)
+            name = name.substr(0, dot);
+    }
+    return name + ".progress." + image_format_extension(options.format);
+}
 
-    // Box 1
-    shared_ptr<hittable> box1 = box(point3(0, 0, 0), point3(165, 330, 165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, vec3(265, 0, 295));
-    world.add(box1);
+void render(camera &cam, const hittable &world, const render_options &options)
+{
+    cam.output_format = options.format;
+    // 自适应采样逐个像素地追加采样，不能使用成组追踪和波前式追踪
+    if (options.adaptive_threshold > 0 && (options.packet_tracing || options.wavefront))
+        std::cerr << "Warning: -k and -w are ignored with adaptive sampling (-a)" << std::endl;
+    cam.adaptive_threshold = options.adaptive_threshold;
+    if (options.adaptive_min_samples > 0)
+        cam.adaptive_min_samples = options.adaptive_min_samples;
+    if (options.adaptive_max_samples > 0)
+        cam.adaptive_max_samples = options.adaptive_max_samples;
+    cam.deterministic = options.deterministic;
+    cam.seed = options.seed;
+    cam.packet_tracing = options.packet_tracing;
+    cam.wavefront = options.wavefront;
+    cam.light_sampling = options.light_sampling;
+    cam.sampler = options.sampler;
+    if (options.image_width > 0)
+        cam.image_width = options.image_width;
+    if (options.samples_per_pixel > 0)
+        cam.samples_per_pixel = options.samples_per_pixel;
+    if (options.max_depth > 0)
+        cam.max_depth = options.max_depth;
 
-    // Box 2
-    shared_ptr<hittable> box2 = box(point3(0, 0, 0), point3(165, 165, 165), white);
-    box2 = make_shared<rotate_y>(box2, -18);
-    box2 = make_shared<translate>(box2, vec3(130, 0, 65));
-    world.add(box2);
+    if (options.samples_per_pass > 0)
+    {
+        cam.time_limit = options.time_limit;
+        cam.progress_file = options.progress_file.empty() ? default_progress_file(options) : options.progress_file;
+        cam.ProgressiveRender(world, options.samples_per_pass);
+    }
+    else
+    {
+        cam.ThreadPoolRender(world);
+    }
+}
 
+/**
+ * @brief 从场景描述文件中读取场景和相机并渲染
+ */
+void scene_from_file(const render_options &options)
+{
+    hittable_list world;
     camera cam;
 
-    cam.aspect_ratio = 1.0;
-    cam.image_width = 600;
-    cam.samples_per_pixel = 64;
-    cam.max_depth = 40;
-    cam.background = color(0, 0, 0);
+    scene_loader loader(world, cam);
+    loader.set_cache_dir(options.cache_dir);
+    loader.load_file(options.scene_file);
 
-    cam.vfov = 40;
-    cam.lookfrom = point3(278, 278, -800);
-    cam.lookat = point3(278, 278, 0);
-    cam.vup = vec3(0, 1, 0);
+    render(cam, world, options);
+}
 
-    cam.defocus_angle = 0;
+/**
+ * @brief 渲染内置场景，最外层使用bvh4
+ */
+void builtin(const builtin_scene &scene, const render_options &options)
+{
+    hittable_list world;
+    camera cam;
+    scene.build(world, cam);
+    world = hittable_list(make_shared<bvh4>(world));
 
-    cam.ThreadPoolRender(world);
+    render(cam, world, options);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    switch (1)
+    // -f 输出格式：p3、ppm、png、pfm
+    // -p 渐进式渲染每一轮的采样数，-t 渐进式渲染的时间上限（秒），-o 渐进式渲染的中间结果文件
+    // -a 自适应采样的相对误差阈值，-s 随机数种子（指定后渲染结果可复现）
+    // -m、-M 自适应采样每个像素的最少、最多采样数（-n为平均每个像素的采样预算）
+    // -k 为1时主光线成组追踪，-w 为1时使用波前式路径追踪，-l 为0时不对光源直接采样
+    // -i 场景描述文件，-r 图片宽度，-n 每个像素的采样数，-d 最大弹射次数
+    // -c 网格缓存目录，场景中的网格及其BVH缓存在其中
+    // -e 内置场景：spheres、cornell_box、cornell_smoke、final_scene
+    // -q 采样器：independent（独立随机数）、sobol（Owen扰乱的Sobol序列）
+    render_options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for '" << arg << "'" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "-f")
+        {
+            if (!parse_image_format(value, options.format))
+            {
+                std::cerr << "Unknown image format '" << value << "', expected p3, ppm, png or pfm" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "-p")
+            options.samples_per_pass = std::atoi(value.c_str());
+        else if (arg == "-o")
+            options.progress_file = value;
+        else if (arg == "-t")
+            options.time_limit = std::atof(value.c_str());
+        else if (arg == "-a")
+            options.adaptive_threshold = std::atof(value.c_str());
+        else if (arg == "-m")
+            options.adaptive_min_samples = std::atoi(value.c_str());
+        else if (arg == "-M")
+            options.adaptive_max_samples = std::atoi(value.c_str());
+        else if (arg == "-s")
+        {
+            options.deterministic = true;
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "-k")
+            options.packet_tracing = std::atoi(value.c_str()) != 0;
+        else if (arg == "-w")
+            options.wavefront = std::atoi(value.c_str()) != 0;
+        else if (arg == "-l")
+            options.light_sampling = std::atoi(value.c_str()) != 0;
+        else if (arg == "-i")
+            options.scene_file = value;
+        else if (arg == "-r")
+            options.image_width = std::atoi(value.c_str());
+        else if (arg == "-n")
+            options.samples_per_pixel = std::atoi(value.c_str());
+        else if (arg == "-d")
+            options.max_depth = std::atoi(value.c_str());
+        else if (arg == "-c")
+            options.cache_dir = value;
+        else if (arg == "-e")
+            options.scene_name = value;
+        else if (arg == "-q")
+        {
+            if (!parse_sampler_type(value, options.sampler))
+            {
+                std::cerr << "Unknown sampler '" << value << "', expected independent or sobol" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-f p3|ppm|png|pfm] [-p samples_per_pass] [-t seconds] [-o progress_file] [-a threshold]"
+                      << " [-m min_spp] [-M max_spp] [-s seed]"
+                      << " [-k 0|1] [-w 0|1] [-l 0|1] [-i scene_file] [-r width] [-n spp] [-d depth]"
+                      << " [-c cache_dir]"
+                      << " [-e spheres|cornell_box|cornell_smoke|final_scene] [-q independent|sobol]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // 场景构建中的随机数也由种子决定
+    if (options.deterministic)
+        seed_random(options.seed);
+
+    if (!options.scene_file.empty())
+    {
+        try
+        {
+            scene_from_file(options);
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    const builtin_scene *scene = find_builtin_scene(options.scene_name.c_str());
+    if (!scene)
     {
-    case 1:
-        cornell_box();
-        break;
+        std::cerr << "Unknown scene '" << options.scene_name << "'" << std::endl;
+        return 1;
     }
+    builtin(*scene, options);
 
     return 0;
 }
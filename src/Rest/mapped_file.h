@@ -0,0 +1,109 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RT_HAS_MMAP 1
+#endif
+
+/**
+ * @brief 以只读方式将整个文件映射到内存，析构时解除映射
+ * 不支持mmap的平台上退化为一次性读入内存
+ */
+class mapped_file
+{
+  public:
+    mapped_file() = default;
+
+    explicit mapped_file(const std::string &path)
+    {
+        open(path);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    ~mapped_file()
+    {
+        close();
+    }
+
+    /**
+     * @brief 映射文件，失败（文件不存在、为空等）时返回false
+     */
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef RT_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *address = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // 映射建立后即可关闭文件描述符
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return false;
+        bytes = static_cast<const unsigned char *>(address);
+        length = size_t(info.st_size);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in || in.tellg() <= 0)
+            return false;
+        buffer.resize(size_t(in.tellg()));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char *>(buffer.data()), buffer.size()))
+        {
+            buffer.clear();
+            return false;
+        }
+        bytes = buffer.data();
+        length = buffer.size();
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef RT_HAS_MMAP
+        if (bytes)
+            ::munmap(const_cast<unsigned char *>(bytes), length);
+#else
+        buffer.clear();
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char *data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifndef RT_HAS_MMAP
+    std::vector<unsigned char> buffer;
+#endif
+};
+
+#endif // !MAPPED_FILE_H
@@ -9,12 +9,30 @@
 #include "vec3.h"
 #include <memory>
 
+// 材质的具体类型，波前式渲染按类型将交点分组后集中着色
+enum class material_kind
+{
+    other, // 未知类型，通过虚函数着色
+    lambertian,
+    metal,
+    dielectric,
+    diffuse_light,
+    isotropic,
+};
+
+constexpr int material_kind_count = 6;
+
 class material
 {
   public:
     virtual ~material() = default;
 
-    virtual color emitted(double u, double v, const point3 &p) const
+    virtual material_kind kind() const
+    {
+        return material_kind::other;
+    }
+
+    virtual color emitted(real u, real v, const point3 &p) const
     {
         return color(0, 0, 0);
     }
@@ -23,9 +41,34 @@ class material
     {
         return false;
     }
+
+    /**
+     * @brief 散射方向按已知的分布采样时返回true（漫反射、各向同性介质），
+     * 此时对光源直接采样，并通过scattering_pdf和eval与散射采样做多重重要性采样；镜面反射和折射返回false
+     */
+    virtual bool samples_lights() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief scatter采样到direction方向的立体角概率密度
+     */
+    virtual real scattering_pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+    {
+        return 0;
+    }
+
+    /**
+     * @brief 光从direction方向射入时，沿r_in反方向散射出去的比例：BSDF与余弦项的乘积（介质中为相函数）
+     */
+    virtual color eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+    {
+        return color(0, 0, 0);
+    }
 };
 
-class lambertian : public material
+class lambertian final : public material
 {
   public:
     lambertian(const color &albedo) : tex(make_shared<solid_color>(albedo))
@@ -35,6 +78,11 @@ class lambertian : public material
     {
     }
 
+    material_kind kind() const override
+    {
+        return material_kind::lambertian;
+    }
+
     bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scatterd) const override
     {
         vec3 scatter_direction = rec.normal + random_unit_vector();
@@ -47,17 +95,42 @@ class lambertian : public material
         return true;
     }
 
+    bool samples_lights() const override
+    {
+        return true;
+    }
+
+    // scatter按余弦分布采样，pdf为cos / pi
+    real scattering_pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const override
+    {
+        real cosine = dot(rec.normal, unit(direction));
+        return cosine > 0 ? cosine / pi : 0;
+    }
+
+    color eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const override
+    {
+        real cosine = dot(rec.normal, unit(direction));
+        if (cosine <= 0)
+            return color(0, 0, 0);
+        return tex->value(rec.u, rec.v, rec.p) * (cosine / pi);
+    }
+
   private:
     shared_ptr<texture> tex;
 };
 
-class metal : public material
+class metal final : public material
 {
   public:
-    metal(const color &albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1)
+    metal(const color &albedo, real fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1)
     {
     }
 
+    material_kind kind() const override
+    {
+        return material_kind::metal;
+    }
+
     bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scatterd) const override
     {
         // 镜面反射
@@ -71,26 +144,31 @@ class metal : public material
 
   private:
     color albedo;
-    double fuzz;
+    real fuzz;
 };
 
-class dielectric : public material
+class dielectric final : public material
 {
   public:
-    dielectric(double refraction_index) : refraction_index(refraction_index)
+    dielectric(real refraction_index) : refraction_index(refraction_index)
     {
     }
 
+    material_kind kind() const override
+    {
+        return material_kind::dielectric;
+    }
+
     bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scatterd) const override
     {
         attenuation = color(1.0, 1.0, 1.0);
         // 根据Snell's law计算入射介质和出射介质比值
-        double r_i = rec.outward ? (1.0 / refraction_index) : refraction_index;
+        real r_i = rec.outward ? (1.0 / refraction_index) : refraction_index;
 
         vec3 unit_in_dir = unit(r_in.direction());
 
-        double cos_theta = std::fmin(1.0, dot(-unit_in_dir, rec.normal));
-        double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+        real cos_theta = std::fmin(1.0, dot(-unit_in_dir, rec.normal));
+        real sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
 
         bool can_refract = sin_theta * r_i <= 1.0;
         vec3 direction;
@@ -114,7 +192,7 @@ class dielectric : public material
   private:
     // Refractive index in vacuum or air, or the ratio of the material's refractive index over
     // the refractive index of the enclosing media
-    double refraction_index;
+    real refraction_index;
 
     /**
      * @brief Schlick's approximation for reflectance
@@ -123,15 +201,15 @@ class dielectric : public material
      * @param refraction_index
      * @return
      */
-    static double reflectance(double consine, double refraction_index)
+    static real reflectance(real consine, real refraction_index)
     {
-        double r0 = (1 - refraction_index) / (1 + refraction_index);
+        real r0 = (1 - refraction_index) / (1 + refraction_index);
         r0 = r0 * r0;
         return r0 + (1 - r0) * std::pow((1 - consine), 5);
     }
 };
 
-class diffuse_light : public material
+class diffuse_light final : public material
 {
   public:
     diffuse_light(shared_ptr<texture> tex) : tex(tex)
@@ -141,7 +219,12 @@ class diffuse_light : public material
     {
     }
 
-    color emitted(double u, double v, const point3 &p) const override
+    material_kind kind() const override
+    {
+        return material_kind::diffuse_light;
+    }
+
+    color emitted(real u, real v, const point3 &p) const override
     {
         return tex->value(u, v, p);
     }
@@ -150,7 +233,7 @@ class diffuse_light : public material
     shared_ptr<texture> tex;
 };
 
-class isotropic : public material
+class isotropic final : public material
 {
   public:
     isotropic(shared_ptr<texture> tex) : tex(tex)
@@ -161,6 +244,11 @@ class isotropic : public material
     {
     }
 
+    material_kind kind() const override
+    {
+        return material_kind::isotropic;
+    }
+
     bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scatterd) const override
     {
         scatterd = ray(rec.p, random_unit_vector(), r_in.time());
@@ -168,6 +256,22 @@ class isotropic : public material
         return true;
     }
 
+    bool samples_lights() const override
+    {
+        return true;
+    }
+
+    // 在球面上均匀采样
+    real scattering_pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const override
+    {
+        return 1 / (4 * pi);
+    }
+
+    color eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const override
+    {
+        return tex->value(rec.u, rec.v, rec.p) / (4 * pi);
+    }
+
   private:
     shared_ptr<texture> tex;
 };
@@ -0,0 +1,123 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mapped_file.h"
+#include "mesh_loader.h"
+#include "triangle_mesh.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace mesh_cache_detail
+{
+
+// 缓存格式或BVH构建方式改变时修改，使旧的缓存失效
+constexpr uint64_t cache_version = 1;
+
+inline uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief 按8字节一组计算文件内容的64位哈希，作为缓存的键
+ * 种子中包含real、vec3和BVH节点的大小，单精度/双精度、SIMD/非SIMD的构建共用缓存目录时各自使用不同的文件，
+ * 不会互相覆盖对方的缓存
+ */
+inline uint64_t hash_bytes(const unsigned char *data, size_t size)
+{
+    uint64_t layout = (uint64_t(sizeof(real)) << 32) ^ (uint64_t(sizeof(vec3)) << 16) ^ sizeof(linear_bvh_node);
+    uint64_t h = mix(cache_version ^ mix(layout) ^ (uint64_t(size) * 0x9e3779b97f4a7c15ULL));
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    return mix(h ^ mix(tail));
+}
+
+inline std::string cache_path(const std::string &cache_dir, uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.rtmesh", static_cast<unsigned long long>(key));
+    if (cache_dir.empty() || cache_dir.back() == '/')
+        return cache_dir + name;
+    return cache_dir + "/" + name;
+}
+
+/**
+ * @brief 写入缓存时使用的临时文件，文件名包含进程号和进程内的计数，
+ * 多个进程（或线程）同时写入同一个缓存时各自写入自己的临时文件，重命名时不会用写了一半的文件覆盖缓存
+ */
+inline std::string temporary_path(const std::string &cached)
+{
+    static std::atomic<unsigned> counter{0};
+#if defined(_WIN32)
+    long pid = _getpid();
+#else
+    long pid = getpid();
+#endif
+    return cached + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+}
+
+} // namespace mesh_cache_detail
+
+/**
+ * @brief 读取OBJ或PLY网格，结果按文件内容的哈希缓存在cache_dir中
+ *
+ * 缓存命中时直接映射缓存文件，跳过解析和BVH构建；未命中时正常读取、构建并写入缓存。
+ * 先写入临时文件再重命名，写入中断时不会留下不完整的缓存文件。
+ * cache_dir为空时不使用缓存
+ *
+ * @param path 网格文件路径
+ * @param mat 网格的材质
+ * @param cache_dir 缓存目录，需要已经存在
+ */
+inline shared_ptr<triangle_mesh> load_mesh_cached(const std::string &path, shared_ptr<material> mat,
+                                                  const std::string &cache_dir)
+{
+    if (cache_dir.empty())
+        return make_shared<triangle_mesh>(load_mesh(path), mat);
+
+    uint64_t key;
+    {
+        mapped_file source;
+        if (!source.open(path))
+            throw std::runtime_error("cannot open mesh file '" + path + "'");
+        key = mesh_cache_detail::hash_bytes(source.data(), source.size());
+    }
+
+    std::string cached = mesh_cache_detail::cache_path(cache_dir, key);
+    if (auto mesh = triangle_mesh::load_cache(cached, key, mat))
+        return mesh;
+
+    auto mesh = make_shared<triangle_mesh>(load_mesh(path), mat);
+    std::string temporary = mesh_cache_detail::temporary_path(cached);
+    if (!mesh->save_cache(temporary, key) || std::rename(temporary.c_str(), cached.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        std::clog << "Warning: cannot write mesh cache '" << cached << "'" << std::endl;
+    }
+    return mesh;
+}
+
+#endif // !MESH_CACHE_H
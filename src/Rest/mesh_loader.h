@@ -0,0 +1,557 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include "triangle_mesh.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// OBJ和PLY网格的流式读取：逐行/逐个元素读取，直接写入mesh_data的数组，不为每个三角形创建对象
+// 多边形按扇形拆分为三角形，出错时抛出std::runtime_error
+namespace mesh_loader_detail
+{
+
+// 将OBJ中从1开始（负数表示从末尾倒数）的索引转换为从0开始的索引
+inline int32_t resolve_obj_index(long index, size_t count, const std::string &path, long line_number)
+{
+    long resolved = index > 0 ? index - 1 : long(count) + index;
+    if (index == 0 || resolved < 0 || resolved >= long(count))
+        throw std::runtime_error(path + ":" + std::to_string(line_number) + ": index out of range");
+    return static_cast<int32_t>(resolved);
+}
+
+// 某个属性第一次出现时，为之前没有该属性的角补上-1；属性出现后每个角都写入索引
+// 不能只用indices是否为空判断属性是否出现，第一个角就带有该属性时数组在写入前也是空的
+inline void push_optional_index(std::vector<int32_t> &indices, size_t corner_count, int32_t index)
+{
+    if (index < 0 && indices.empty())
+        return;
+    indices.resize(corner_count, -1);
+    indices.push_back(index);
+}
+
+// PLY中属性的数据类型
+enum class ply_type
+{
+    int8,
+    uint8,
+    int16,
+    uint16,
+    int32,
+    uint32,
+    float32,
+    float64,
+};
+
+inline ply_type parse_ply_type(const std::string &name)
+{
+    if (name == "char" || name == "int8")
+        return ply_type::int8;
+    if (name == "uchar" || name == "uint8")
+        return ply_type::uint8;
+    if (name == "short" || name == "int16")
+        return ply_type::int16;
+    if (name == "ushort" || name == "uint16")
+        return ply_type::uint16;
+    if (name == "int" || name == "int32")
+        return ply_type::int32;
+    if (name == "uint" || name == "uint32")
+        return ply_type::uint32;
+    if (name == "float" || name == "float32")
+        return ply_type::float32;
+    if (name == "double" || name == "float64")
+        return ply_type::float64;
+    throw std::runtime_error("unknown PLY property type '" + name + "'");
+}
+
+inline size_t ply_type_size(ply_type type)
+{
+    switch (type)
+    {
+    case ply_type::int8:
+    case ply_type::uint8:
+        return 1;
+    case ply_type::int16:
+    case ply_type::uint16:
+        return 2;
+    case ply_type::int32:
+    case ply_type::uint32:
+    case ply_type::float32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+struct ply_property
+{
+    std::string name;
+    ply_type type;
+    bool is_list = false;
+    ply_type count_type = ply_type::uint8; // 列表长度的类型
+};
+
+struct ply_element
+{
+    std::string name;
+    size_t count = 0;
+    std::vector<ply_property> properties;
+};
+
+/**
+ * @brief 按PLY的存储格式逐个读取数值
+ */
+class ply_reader
+{
+  public:
+    enum class format
+    {
+        ascii,
+        binary_little_endian,
+        binary_big_endian,
+    };
+
+    ply_reader(std::istream &in, format fmt) : in(in), fmt(fmt)
+    {
+    }
+
+    double read(ply_type type)
+    {
+        if (fmt == format::ascii)
+        {
+            double value;
+            if (!(in >> value))
+                throw std::runtime_error("unexpected end of PLY data");
+            return value;
+        }
+
+        unsigned char bytes[8];
+        size_t size = ply_type_size(type);
+        if (!in.read(reinterpret_cast<char *>(bytes), size))
+            throw std::runtime_error("unexpected end of PLY data");
+        if (big_endian_host() != (fmt == format::binary_big_endian))
+            std::reverse(bytes, bytes + size);
+
+        switch (type)
+        {
+        case ply_type::int8:
+            return load<int8_t>(bytes);
+        case ply_type::uint8:
+            return load<uint8_t>(bytes);
+        case ply_type::int16:
+            return load<int16_t>(bytes);
+        case ply_type::uint16:
+            return load<uint16_t>(bytes);
+        case ply_type::int32:
+            return load<int32_t>(bytes);
+        case ply_type::uint32:
+            return load<uint32_t>(bytes);
+        case ply_type::float32:
+            return load<float>(bytes);
+        default:
+            return load<double>(bytes);
+        }
+    }
+
+  private:
+    std::istream &in;
+    format fmt;
+
+    template <class T> static T load(const unsigned char *bytes)
+    {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    static bool big_endian_host()
+    {
+        const uint16_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        return first == 0;
+    }
+};
+
+} // namespace mesh_loader_detail
+
+/**
+ * @brief 流式读取OBJ文件中的顶点（v）、法线（vn）、纹理坐标（vt）和面（f），忽略其他语句
+ *
+ * @param path 文件路径
+ * @return 网格数据
+ */
+inline mesh_data load_obj(const std::string &path)
+{
+    using namespace mesh_loader_detail;
+
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("cannot open mesh file '" + path + "'");
+
+    mesh_data mesh;
+    std::string line;
+    long line_number = 0;
+    // 当前面的各个角，复用以避免每个面分配内存
+    std::vector<int32_t> face_positions, face_normals, face_uvs;
+
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        const char *p = line.c_str();
+        while (*p == ' ' || *p == '\t')
+            ++p;
+
+        auto fail = [&](const char *message) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": " + message);
+        };
+        auto read_real = [&](const char *&cursor) {
+            char *end;
+            double value = std::strtod(cursor, &end);
+            if (end == cursor)
+                fail("expected a number");
+            cursor = end;
+            return static_cast<real>(value);
+        };
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            p += 2;
+            real x = read_real(p), y = read_real(p), z = read_real(p);
+            mesh.positions.emplace_back(x, y, z);
+        }
+        else if (p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+        {
+            p += 3;
+            real x = read_real(p), y = read_real(p), z = read_real(p);
+            mesh.normals.emplace_back(x, y, z);
+        }
+        else if (p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+        {
+            p += 3;
+            real u = read_real(p);
+            // 只有一个分量的纹理坐标v取0
+            char *end;
+            double v = std::strtod(p, &end);
+            mesh.uvs.push_back(u);
+            mesh.uvs.push_back(static_cast<real>(end == p ? 0 : v));
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            p += 2;
+            face_positions.clear();
+            face_normals.clear();
+            face_uvs.clear();
+
+            // 每个角的形式为v、v/vt、v//vn或v/vt/vn
+            while (true)
+            {
+                while (*p == ' ' || *p == '\t' || *p == '\r')
+                    ++p;
+                if (*p == '\0')
+                    break;
+
+                char *end;
+                long v = std::strtol(p, &end, 10);
+                if (end == p)
+                    fail("expected a vertex index");
+                p = end;
+                long vt = 0, vn = 0;
+                if (*p == '/')
+                {
+                    ++p;
+                    if (*p != '/')
+                    {
+                        vt = std::strtol(p, &end, 10);
+                        if (end == p)
+                            fail("expected a texture coordinate index");
+                        p = end;
+                    }
+                    if (*p == '/')
+                    {
+                        ++p;
+                        vn = std::strtol(p, &end, 10);
+                        if (end == p)
+                            fail("expected a normal index");
+                        p = end;
+                    }
+                }
+
+                face_positions.push_back(resolve_obj_index(v, mesh.positions.size(), path, line_number));
+                face_uvs.push_back(vt == 0 ? -1 : resolve_obj_index(vt, mesh.uvs.size() / 2, path, line_number));
+                face_normals.push_back(vn == 0 ? -1 : resolve_obj_index(vn, mesh.normals.size(), path, line_number));
+            }
+
+            if (face_positions.size() < 3)
+                fail("face has fewer than 3 vertices");
+
+            // 扇形拆分为三角形
+            for (size_t k = 1; k + 1 < face_positions.size(); ++k)
+            {
+                const size_t corners[3] = {0, k, k + 1};
+                for (size_t c : corners)
+                {
+                    size_t corner_count = mesh.position_indices.size();
+                    push_optional_index(mesh.normal_indices, corner_count, face_normals[c]);
+                    push_optional_index(mesh.uv_indices, corner_count, face_uvs[c]);
+                    mesh.position_indices.push_back(face_positions[c]);
+                }
+            }
+        }
+    }
+
+    mesh.validate();
+    return mesh;
+}
+
+/**
+ * @brief 流式读取PLY文件（ascii、binary_little_endian、binary_big_endian），
+ * 读取vertex元素的x、y、z、nx、ny、nz、u、v（或s、t）属性和face元素的顶点索引列表，其他元素和属性被跳过
+ *
+ * @param path 文件路径
+ * @return 网格数据，顶点的各属性共用位置的索引
+ */
+inline mesh_data load_ply(const std::string &path)
+{
+    using namespace mesh_loader_detail;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("cannot open mesh file '" + path + "'");
+
+    auto fail = [&](const std::string &message) { throw std::runtime_error(path + ": " + message); };
+
+    // 读取文件头
+    std::string line;
+    if (!std::getline(in, line) || line.compare(0, 3, "ply") != 0)
+        fail("not a PLY file");
+
+    ply_reader::format fmt = ply_reader::format::ascii;
+    std::vector<ply_element> elements;
+    while (true)
+    {
+        if (!std::getline(in, line))
+            fail("unexpected end of header");
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "end_header")
+            break;
+
+        if (keyword == "format")
+        {
+            std::string name;
+            tokens >> name;
+            if (name == "ascii")
+                fmt = ply_reader::format::ascii;
+            else if (name == "binary_little_endian")
+                fmt = ply_reader::format::binary_little_endian;
+            else if (name == "binary_big_endian")
+                fmt = ply_reader::format::binary_big_endian;
+            else
+                fail("unknown format '" + name + "'");
+        }
+        else if (keyword == "element")
+        {
+            ply_element element;
+            if (!(tokens >> element.name >> element.count))
+                fail("malformed element '" + line + "'");
+            elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+                fail("property before any element");
+            ply_property property;
+            std::string type;
+            tokens >> type;
+            if (type == "list")
+            {
+                std::string count_type, item_type;
+                tokens >> count_type >> item_type;
+                property.is_list = true;
+                property.count_type = parse_ply_type(count_type);
+                property.type = parse_ply_type(item_type);
+            }
+            else
+            {
+                property.type = parse_ply_type(type);
+            }
+            if (!(tokens >> property.name))
+                fail("malformed property '" + line + "'");
+            elements.back().properties.push_back(property);
+        }
+        // comment、obj_info等语句被忽略
+    }
+
+    // 每个元素的一行至少占用的字节数（二进制为各个数值和列表长度的大小，ascii为每个数值一个字符加一个分隔符），
+    // 元素个数乘以它不能超过剩余的文件大小，损坏的文件头不会导致按巨大的个数分配内存或空转
+    {
+        std::streampos data_start = in.tellg();
+        in.seekg(0, std::ios::end);
+        uint64_t remaining = uint64_t(in.tellg() - data_start);
+        in.seekg(data_start);
+        // ascii文件最后一个数值之后可以没有分隔符
+        if (fmt == ply_reader::format::ascii)
+            ++remaining;
+
+        for (const ply_element &element : elements)
+        {
+            uint64_t row = 0;
+            for (const ply_property &property : element.properties)
+            {
+                if (fmt == ply_reader::format::ascii)
+                    row += 2;
+                else
+                    row += ply_type_size(property.is_list ? property.count_type : property.type);
+            }
+            row = std::max<uint64_t>(row, 1);
+            if (element.count > remaining / row)
+                fail("element '" + element.name + "' count " + std::to_string(element.count) +
+                     " exceeds the file size");
+            remaining -= element.count * row;
+        }
+    }
+
+    mesh_data mesh;
+    ply_reader reader(in, fmt);
+    std::vector<double> values;
+    std::vector<int32_t> face;
+
+    for (const ply_element &element : elements)
+    {
+        // 各个属性在values中的下标，不存在时为-1
+        auto find = [&](std::initializer_list<const char *> names) {
+            for (const char *name : names)
+            {
+                for (size_t i = 0; i < element.properties.size(); ++i)
+                {
+                    if (element.properties[i].name == name && !element.properties[i].is_list)
+                        return int(i);
+                }
+            }
+            return -1;
+        };
+
+        if (element.name == "vertex")
+        {
+            int x = find({"x"}), y = find({"y"}), z = find({"z"});
+            int nx = find({"nx"}), ny = find({"ny"}), nz = find({"nz"});
+            int u = find({"u", "s", "texture_u", "texture_s"}), v = find({"v", "t", "texture_v", "texture_t"});
+            if (x < 0 || y < 0 || z < 0)
+                fail("vertex element has no x, y, z");
+            bool has_normals = nx >= 0 && ny >= 0 && nz >= 0;
+            bool has_uvs = u >= 0 && v >= 0;
+
+            mesh.positions.reserve(element.count);
+            values.resize(element.properties.size());
+            for (size_t n = 0; n < element.count; ++n)
+            {
+                for (size_t i = 0; i < element.properties.size(); ++i)
+                {
+                    const ply_property &property = element.properties[i];
+                    if (property.is_list)
+                    {
+                        size_t length = size_t(reader.read(property.count_type));
+                        for (size_t k = 0; k < length; ++k)
+                            reader.read(property.type);
+                        continue;
+                    }
+                    values[i] = reader.read(property.type);
+                }
+                mesh.positions.emplace_back(values[x], values[y], values[z]);
+                if (has_normals)
+                    mesh.normals.emplace_back(values[nx], values[ny], values[nz]);
+                if (has_uvs)
+                {
+                    mesh.uvs.push_back(static_cast<real>(values[u]));
+                    mesh.uvs.push_back(static_cast<real>(values[v]));
+                }
+            }
+        }
+        else if (element.name == "face")
+        {
+            bool has_indices = false;
+            for (size_t n = 0; n < element.count; ++n)
+            {
+                for (const ply_property &property : element.properties)
+                {
+                    if (!property.is_list)
+                    {
+                        reader.read(property.type);
+                        continue;
+                    }
+
+                    size_t length = size_t(reader.read(property.count_type));
+                    bool is_indices = property.name == "vertex_indices" || property.name == "vertex_index";
+                    face.clear();
+                    for (size_t k = 0; k < length; ++k)
+                        face.push_back(static_cast<int32_t>(reader.read(property.type)));
+                    if (!is_indices)
+                        continue;
+
+                    has_indices = true;
+                    if (length < 3)
+                        fail("face has fewer than 3 vertices");
+                    for (size_t k = 1; k + 1 < length; ++k)
+                    {
+                        mesh.position_indices.push_back(face[0]);
+                        mesh.position_indices.push_back(face[k]);
+                        mesh.position_indices.push_back(face[k + 1]);
+                    }
+                }
+            }
+            if (element.count > 0 && !has_indices)
+                fail("face element has no vertex_indices");
+        }
+        else
+        {
+            // 跳过其他元素
+            for (size_t n = 0; n < element.count; ++n)
+            {
+                for (const ply_property &property : element.properties)
+                {
+                    size_t length = property.is_list ? size_t(reader.read(property.count_type)) : 1;
+                    for (size_t k = 0; k < length; ++k)
+                        reader.read(property.type);
+                }
+            }
+        }
+    }
+
+    // PLY的各个属性按顶点存储，与位置共用索引
+    if (!mesh.normals.empty())
+        mesh.normal_indices = mesh.position_indices;
+    if (!mesh.uvs.empty())
+        mesh.uv_indices = mesh.position_indices;
+
+    mesh.validate();
+    return mesh;
+}
+
+/**
+ * @brief 根据扩展名（.obj或.ply，不区分大小写）读取网格
+ */
+inline mesh_data load_mesh(const std::string &path)
+{
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == "obj")
+        return load_obj(path);
+    if (extension == "ply")
+        return load_ply(path);
+    throw std::runtime_error("unknown mesh format '" + path + "', expected .obj or .ply");
+}
+
+#endif // !MESH_LOADER_H
@@ -0,0 +1,127 @@
+// 网格读取的检查：写出小的OBJ和PLY文件，读取后核对每个角的位置、纹理坐标和法线索引，
+// 以及文件头损坏的PLY文件按std::runtime_error报错
+// 通过ctest运行，失败时返回非0
+
+#include "mesh_loader.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+int failures = 0;
+
+void expect_indices(const std::string &name, const std::vector<int32_t> &actual, const std::vector<int32_t> &expected)
+{
+    if (actual == expected)
+        return;
+    ++failures;
+    std::cerr << name << ": expected";
+    for (int32_t index : expected)
+        std::cerr << ' ' << index;
+    std::cerr << ", got";
+    for (int32_t index : actual)
+        std::cerr << ' ' << index;
+    std::cerr << std::endl;
+}
+
+mesh_data load_text(const std::string &text, const std::string &extension = "obj")
+{
+    const std::string path = "mesh_loader_check." + extension;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    try
+    {
+        mesh_data mesh = load_mesh(path);
+        std::remove(path.c_str());
+        return mesh;
+    }
+    catch (...)
+    {
+        std::remove(path.c_str());
+        throw;
+    }
+}
+
+// 读取应当失败并抛出std::runtime_error（而不是其他异常或终止程序）
+void expect_error(const std::string &name, const std::string &text, const std::string &extension)
+{
+    try
+    {
+        load_text(text, extension);
+        ++failures;
+        std::cerr << name << ": expected an error" << std::endl;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+}
+
+} // namespace
+
+int main()
+{
+    const std::string vertices = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                                 "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                                 "vn 0 0 1\nvn 0 0 -1\n";
+
+    try
+    {
+        // 第一个面就带有纹理坐标和法线
+        mesh_data mesh = load_text(vertices + "f 1/1/1 2/2/1 3/3/2\n");
+        expect_indices("v/vt/vn positions", mesh.position_indices, {0, 1, 2});
+        expect_indices("v/vt/vn uvs", mesh.uv_indices, {0, 1, 2});
+        expect_indices("v/vt/vn normals", mesh.normal_indices, {0, 0, 1});
+
+        // 四边形按扇形拆分，负数索引从末尾倒数
+        mesh = load_text(vertices + "f -4/-4/-2 -3/-3/-2 -2/-2/-2 -1/-1/-2\n");
+        expect_indices("quad positions", mesh.position_indices, {0, 1, 2, 0, 2, 3});
+        expect_indices("quad uvs", mesh.uv_indices, {0, 1, 2, 0, 2, 3});
+        expect_indices("quad normals", mesh.normal_indices, {0, 0, 0, 0, 0, 0});
+
+        // 属性在之后的面中才出现时，之前的角补-1
+        mesh = load_text(vertices + "f 1 2 3\nf 1//2 3//2 4//2\nf 1/1 3/3 4/4\n");
+        expect_indices("mixed positions", mesh.position_indices, {0, 1, 2, 0, 2, 3, 0, 2, 3});
+        expect_indices("mixed uvs", mesh.uv_indices, {-1, -1, -1, -1, -1, -1, 0, 2, 3});
+        expect_indices("mixed normals", mesh.normal_indices, {-1, -1, -1, 1, 1, 1, -1, -1, -1});
+
+        // 没有纹理坐标和法线的网格，两个索引数组都为空
+        mesh = load_text(vertices + "f 1 2 3\n");
+        expect_indices("plain uvs", mesh.uv_indices, {});
+        expect_indices("plain normals", mesh.normal_indices, {});
+
+        // ascii PLY，四边形按扇形拆分
+        const std::string ply_vertices = "element vertex 4\nproperty float x\nproperty float y\nproperty float z\n";
+        const std::string ply_faces = "element face 1\nproperty list uchar int vertex_indices\nend_header\n";
+        mesh = load_text("ply\nformat ascii 1.0\n" + ply_vertices + ply_faces +
+                             "0 0 0\n1 0 0\n1 1 0\n0 1 0\n4 0 1 2 3",
+                         "ply");
+        expect_indices("ply positions", mesh.position_indices, {0, 1, 2, 0, 2, 3});
+
+        // 元素个数超过文件能容纳的数量
+        expect_error("ply ascii huge count",
+                     "ply\nformat ascii 1.0\nelement vertex 99999999999999\nproperty float x\nproperty float y\n"
+                     "property float z\nend_header\n0 0 0\n",
+                     "ply");
+        expect_error("ply binary huge count",
+                     "ply\nformat binary_little_endian 1.0\n" + ply_vertices +
+                         "element face 99999999999999\nproperty list uchar int vertex_indices\nend_header\n" +
+                         std::string(4 * 12, '\0'),
+                     "ply");
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0)
+        return 1;
+    std::cout << "mesh loader checks passed" << std::endl;
+    return 0;
+}
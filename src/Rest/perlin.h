@@ -1,8 +1,8 @@
 #ifndef PERLIN_H
 #define PERLIN_H
 
-#include "NextWeek/global.h"
-#include "NextWeek/vec3.h"
+#include "global.h"
+#include "vec3.h"
 #include <cmath>
 #include <utility>
 class perlin
@@ -20,11 +20,11 @@ class perlin
         perlin_generate_perm(perm_z);
     }
 
-    double noise(const point3 &p) const
+    real noise(const point3 &p) const
     {
-        double u = p.x() - std::floor(p.x());
-        double v = p.y() - std::floor(p.y());
-        double w = p.z() - std::floor(p.z());
+        real u = p.x() - std::floor(p.x());
+        real v = p.y() - std::floor(p.y());
+        real w = p.z() - std::floor(p.z());
 
         // Hermite cubic
 
@@ -52,11 +52,11 @@ class perlin
         return perlin_interp(c, u, v, w);
     }
 
-    double turb(const point3 &p, int depth) const
+    real turb(const point3 &p, int depth) const
     {
-        double accum = 0.0;
+        real accum = 0.0;
         point3 tmp_p = p;
-        double weight = 1.0;
+        real weight = 1.0;
 
         for (int i = 0; i < depth; ++i)
         {
@@ -70,7 +70,7 @@ class perlin
 
   private:
     static const int point_count = 256;
-    // double randfloat[point_count];
+    // real randfloat[point_count];
     vec3 randvec[point_count];
     int perm_x[point_count];
     int perm_y[point_count];
@@ -102,9 +102,9 @@ class perlin
      * @param w z轴权重
      * @return 插值结果
      */
-    static double trilinear_interp(double c[2][2][2], double u, double v, double w)
+    static real trilinear_interp(real c[2][2][2], real u, real v, real w)
     {
-        double accum = 0.0;
+        real accum = 0.0;
         for (int i = 0; i < 2; ++i)
         {
             for (int j = 0; j < 2; ++j)
@@ -119,7 +119,7 @@ class perlin
         return accum;
     }
 
-    static double fade(double x)
+    static real fade(real x)
     {
         // 初始的缓和曲线计算方法，一阶导连续
         // return x * x * (3 - 2 * x);
@@ -127,13 +127,13 @@ class perlin
         return x * x * x * (10 - 15 * x + 6 * x * x);
     }
 
-    static double perlin_interp(vec3 c[2][2][2], double u, double v, double w)
+    static real perlin_interp(vec3 c[2][2][2], real u, real v, real w)
     {
-        double accum = 0.0;
+        real accum = 0.0;
 
-        double uu = fade(u);
-        double vv = fade(v);
-        double ww = fade(w);
+        real uu = fade(u);
+        real vv = fade(v);
+        real ww = fade(w);
 
         for (int i = 0; i < 2; ++i)
         {
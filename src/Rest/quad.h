@@ -1,12 +1,12 @@
 #ifndef QUAD_H
 #define QUAD_H
 
-#include "NextWeek/aabb.h"
-#include "NextWeek/global.h"
-#include "NextWeek/hittable_list.h"
-#include "NextWeek/interval.h"
-#include "NextWeek/material.h"
-#include "NextWeek/vec3.h"
+#include "aabb.h"
+#include "global.h"
+#include "hittable_list.h"
+#include "interval.h"
+#include "material.h"
+#include "vec3.h"
 #include "hittable.h"
 #include <cmath>
 #include <memory>
@@ -20,6 +20,7 @@ class quad : public hittable
         normal = unit(n);
         D = dot(normal, Q);
         w = n / dot(n, n);
+        area = n.length();
         set_bounding_box();
     }
 
@@ -37,34 +38,65 @@ class quad : public hittable
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
-        double denom = dot(normal, r.direction());
-
-        if (std::fabs(denom) < 1e-8)
+        real t, alpha, beta;
+        point3 intersection;
+        if (!plane_hit(r, ray_t, t, intersection, alpha, beta) || !is_interior(alpha, beta, rec))
             return false;
 
-        double t = (D - dot(normal, r.origin())) / denom;
-
-        if (!ray_t.contains(t))
-            return false;
+        // is_interior已经写入纹理坐标，其余属性在finish_hit中计算
+        rec.t = t;
+        rec.pending = this;
 
-        point3 intersection = r.at(t);
-        vec3 planar_hitpt_vec = intersection - Q;
+        return true;
+    }
 
-        double alpha = dot(w, cross(planar_hitpt_vec, v));
-        double beta = dot(w, cross(u, planar_hitpt_vec));
+    void finish_hit(const ray &r, hit_record &rec) const override
+    {
+        rec.p = r.at(rec.t);
+        rec.mat = mat.get();
+        rec.object = this;
+        rec.set_face_normal(r, normal);
+    }
 
-        if (!is_interior(alpha, beta, rec))
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        real t, alpha, beta;
+        point3 intersection;
+        if (!plane_hit(r, ray_t, t, intersection, alpha, beta))
             return false;
+        // is_interior会写入纹理坐标，传入临时记录
+        hit_record rec;
+        return is_interior(alpha, beta, rec);
+    }
 
-        rec.t = t;
-        rec.p = intersection;
-        rec.mat = mat;
-        rec.set_face_normal(r, normal);
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        if (mat && mat->kind() == material_kind::diffuse_light && area > 0)
+            lights.push_back(this);
+    }
 
+    // 在四边形上均匀采样一点，面积测度的pdf为1 / area，转换为从origin看的立体角测度
+    bool sample_light(const point3 &origin, light_sample &sample) const override
+    {
+        double u1, u2;
+        random_double_2d(u1, u2);
+        real a = real(u1), b = real(u2);
+        sample.p = Q + a * u + b * v;
+        sample.pdf = solid_angle_pdf(origin, sample.p);
+        if (sample.pdf <= 0)
+            return false;
+        sample.u = a;
+        sample.v = b;
+        sample.mat = mat.get();
         return true;
     }
 
-    virtual bool is_interior(double a, double b, hit_record &rec) const
+    real light_pdf(const point3 &origin, const hit_record &rec) const override
+    {
+        return solid_angle_pdf(origin, rec.p);
+    }
+
+    virtual bool is_interior(real a, real b, hit_record &rec) const
     {
         interval unit_interval = interval(0, 1);
 
@@ -83,9 +115,46 @@ class quad : public hittable
     vec3 u, v;
     vec3 w;
     vec3 normal;
-    double D;
+    real D;
+    real area;
     shared_ptr<material> mat;
     aabb bbox;
+
+    /**
+     * @brief 求光线与四边形所在平面在ray_t内的交点，alpha和beta为交点在u、v方向上的平面坐标
+     */
+    bool plane_hit(const ray &r, interval ray_t, real &t, point3 &intersection, real &alpha, real &beta) const
+    {
+        real denom = dot(normal, r.direction());
+
+        if (std::fabs(denom) < parallel_epsilon)
+            return false;
+
+        t = (D - dot(normal, r.origin())) / denom;
+
+        if (!ray_t.contains(t))
+            return false;
+
+        intersection = r.at(t);
+        vec3 planar_hitpt_vec = intersection - Q;
+
+        alpha = dot(w, cross(planar_hitpt_vec, v));
+        beta = dot(w, cross(u, planar_hitpt_vec));
+        return true;
+    }
+
+    // 从origin看p所在方向的立体角概率密度，视线与四边形平行时返回0
+    real solid_angle_pdf(const point3 &origin, const point3 &p) const
+    {
+        vec3 to_point = p - origin;
+        real distance_squared = to_point.length_squared();
+        if (distance_squared <= 0)
+            return 0;
+        real cosine = std::fabs(dot(normal, to_point)) / std::sqrt(distance_squared);
+        if (cosine < parallel_epsilon)
+            return 0;
+        return distance_squared / (cosine * area);
+    }
 };
 
 inline shared_ptr<hittable_list> box(const point3 &a, const point3 &b, shared_ptr<material> mat)
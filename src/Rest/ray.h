@@ -11,7 +11,7 @@ class ray
     {
     }
 
-    ray(const point3 &origin, const vec3 &direction, double time) : orig(origin), dir(direction), tm(time)
+    ray(const point3 &origin, const vec3 &direction, real time) : orig(origin), dir(direction), tm(time)
     {
     }
 
@@ -29,12 +29,12 @@ class ray
         return dir;
     }
 
-    double time() const
+    real time() const
     {
         return tm;
     }
 
-    point3 at(double t) const
+    point3 at(real t) const
     {
         return orig + t * dir;
     }
@@ -42,7 +42,7 @@ class ray
   private:
     point3 orig;
     vec3 dir;
-    double tm;
+    real tm;
 };
 
 #endif // !RAY_H
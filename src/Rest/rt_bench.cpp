@@ -0,0 +1,553 @@
+// 渲染基准测试
+// 以固定的分辨率、采样数和随机数种子渲染内置场景，输出每秒追踪的光线数、BVH构建时间、各阶段耗时和峰值内存（JSON），
+// 可以指定多个线程数测试多线程扩展性，并与之前保存的结果比较，性能下降超过阈值时返回2，
+// 基准结果的渲染配置（分辨率、采样数、弹射次数、种子、渲染方式、采样器、浮点类型）与本次不同时拒绝比较并返回1
+
+#include "bvh4.h"
+#include "camera.h"
+#include "global.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "scenes.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+
+/**
+ * @brief 包装场景，统计对场景求交的光线数（相机光线、每次弹射的光线和阴影光线）
+ * 每个线程使用独立缓存行上的计数器，避免计数本身影响多线程扩展性
+ */
+class counting_hittable : public hittable
+{
+  public:
+    explicit counting_hittable(shared_ptr<hittable> object) : object(object)
+    {
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        slot().fetch_add(1, std::memory_order_relaxed);
+        return object->hit(r, ray_t, rec);
+    }
+
+    void hit_packet(const ray *rays, int count, real t_min, real *t_max, hit_record *recs,
+                    uint32_t &hit_mask) const override
+    {
+        slot().fetch_add(uint64_t(count), std::memory_order_relaxed);
+        object->hit_packet(rays, count, t_min, t_max, recs, hit_mask);
+    }
+
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        slot().fetch_add(1, std::memory_order_relaxed);
+        return object->occluded(r, ray_t);
+    }
+
+    aabb bounding_box() const override
+    {
+        return object->bounding_box();
+    }
+
+    // 转发给被包装的场景，否则相机的光源列表为空，不会对光源直接采样
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        object->collect_lights(lights);
+    }
+
+    uint64_t rays() const
+    {
+        uint64_t total = 0;
+        for (const counter &c : counters)
+            total += c.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void reset()
+    {
+        for (counter &c : counters)
+            c.value.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr int slot_count = 256;
+
+    struct alignas(64) counter
+    {
+        std::atomic<uint64_t> value{0};
+    };
+
+    shared_ptr<hittable> object;
+    mutable counter counters[slot_count];
+
+    std::atomic<uint64_t> &slot() const
+    {
+        static std::atomic<int> next_thread(0);
+        thread_local int index = next_thread++ % slot_count;
+        return counters[index].value;
+    }
+};
+
+// 丢弃写入的内容，渲染时用于屏蔽相机的进度输出
+class null_buffer : public std::streambuf
+{
+  protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+};
+
+// 进程的峰值常驻内存（KB），不支持时返回0
+long peak_rss_kb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+uint64_t fnv1a(const std::string &data)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : data)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct bench_options
+{
+    std::vector<std::string> scenes; // 为空时测试所有内置场景
+    std::vector<int> threads;        // 为空时使用硬件线程数
+    int image_width = 200;
+    int samples_per_pixel = 16;
+    int max_depth = 0; // 为0时使用场景的设置
+    uint64_t seed = 1;
+    int warmup = 1; // 每个配置正式计时前不计时渲染的次数，使缓存、内存分配和CPU频率进入稳定状态
+    int repeat = 3; // 每个配置计时渲染的次数，取中位数
+    bool packet_tracing = false;
+    bool wavefront = false;
+    bool light_sampling = true;
+    sampler_type sampler = sampler_type::independent;
+    std::string output_file;   // 为空时输出到标准输出
+    std::string baseline_file; // 比较的基准结果
+    double tolerance = 0.05;   // 允许的性能下降比例
+};
+
+struct bench_result
+{
+    std::string scene;
+    int threads = 0;
+    int width = 0, height = 0, samples_per_pixel = 0, max_depth = 0;
+    std::string config; // 影响渲染工作量的全部设置，与基准结果比较时必须一致
+    uint64_t rays = 0;
+    double mrays_per_second = 0;      // 按中位数的追踪时间计算
+    double best_mrays_per_second = 0; // 按最快一次的追踪时间计算
+    double scene_seconds = 0; // 创建场景中的物体（包括嵌套的BVH）
+    double build_seconds = 0; // 构建最外层的bvh4
+    double trace_seconds = 0; // 中位数
+    double output_seconds = 0;
+    long peak_rss_kb = 0;
+    uint64_t image_hash = 0; // 输出图片的哈希，固定种子下应当不随线程数变化
+};
+
+/**
+ * @brief 描述一次测试的渲染配置，只包含影响渲染工作量的设置（不包含线程数、重复次数）
+ */
+std::string render_config(const bench_options &options, const bench_result &result)
+{
+    std::ostringstream out;
+    out << "width=" << result.width << " height=" << result.height << " spp=" << result.samples_per_pixel
+        << " depth=" << result.max_depth << " seed=" << options.seed << " packet=" << options.packet_tracing
+        << " wavefront=" << options.wavefront << " lights=" << options.light_sampling
+        << " sampler=" << sampler_type_name(options.sampler)
+        << " real=" << (sizeof(real) == sizeof(float) ? "float" : "double")
+#ifdef RT_SIMD_VEC3
+        << " simd_vec3=1";
+#else
+        << " simd_vec3=0";
+#endif
+    return out.str();
+}
+
+/**
+ * @brief 构建场景，对每个线程数先做预热渲染，再渲染repeat次取中位数
+ */
+void run_scene(const builtin_scene &scene, const bench_options &options, std::vector<bench_result> &results)
+{
+    // 场景构建使用全局随机数，每个场景都从同一个种子开始
+    seed_random(options.seed);
+
+    auto scene_start = std::chrono::steady_clock::now();
+    hittable_list objects;
+    camera cam;
+    scene.build(objects, cam);
+    double scene_seconds = seconds_since(scene_start);
+
+    auto build_start = std::chrono::steady_clock::now();
+    auto bvh = make_shared<bvh4>(objects);
+    double build_seconds = seconds_since(build_start);
+    counting_hittable world(bvh);
+
+    cam.image_width = options.image_width;
+    cam.samples_per_pixel = options.samples_per_pixel;
+    if (options.max_depth > 0)
+        cam.max_depth = options.max_depth;
+    cam.deterministic = true;
+    cam.seed = options.seed;
+    cam.packet_tracing = options.packet_tracing;
+    cam.wavefront = options.wavefront;
+    cam.light_sampling = options.light_sampling;
+    cam.sampler = options.sampler;
+
+    std::vector<int> thread_counts = options.threads;
+    if (thread_counts.empty())
+        thread_counts.push_back(0);
+
+    for (int threads : thread_counts)
+    {
+        cam.thread_count = threads;
+
+        // 图片写入内存，相机的进度信息丢弃
+        std::ostringstream image;
+        int warmup = std::max(options.warmup, 0);
+        int repeat = std::max(options.repeat, 1);
+        // 每次计时渲染的(追踪时间, 输出时间)
+        std::vector<std::pair<double, double>> timings;
+        for (int run = 0; run < warmup + repeat; ++run)
+        {
+            world.reset();
+            image.str("");
+            null_buffer discard;
+            std::streambuf *cout_buffer = std::cout.rdbuf(image.rdbuf());
+            std::streambuf *clog_buffer = std::clog.rdbuf(&discard);
+            cam.ThreadPoolRender(world);
+            std::cout.rdbuf(cout_buffer);
+            std::clog.rdbuf(clog_buffer);
+
+            if (run >= warmup)
+                timings.emplace_back(cam.trace_seconds, cam.output_seconds);
+        }
+        // 偶数次时取较快的中间值
+        std::sort(timings.begin(), timings.end());
+        double best_seconds = timings.front().first;
+        double trace_seconds = timings[(timings.size() - 1) / 2].first;
+        double output_seconds = timings[(timings.size() - 1) / 2].second;
+
+        bench_result result;
+        result.scene = scene.name;
+        result.threads = threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+        result.width = cam.image_width;
+        result.height = std::max(1, int(cam.image_width / cam.aspect_ratio));
+        result.samples_per_pixel = cam.samples_per_pixel;
+        result.max_depth = cam.max_depth;
+        result.config = render_config(options, result);
+        result.rays = world.rays();
+        result.mrays_per_second = trace_seconds > 0 ? result.rays / trace_seconds * 1e-6 : 0;
+        result.best_mrays_per_second = best_seconds > 0 ? result.rays / best_seconds * 1e-6 : 0;
+        result.scene_seconds = scene_seconds;
+        result.build_seconds = build_seconds;
+        result.trace_seconds = trace_seconds;
+        result.output_seconds = output_seconds;
+        result.peak_rss_kb = peak_rss_kb();
+        result.image_hash = fnv1a(image.str());
+        results.push_back(result);
+
+        std::cerr << std::left << std::setw(14) << result.scene << std::right << " threads " << std::setw(3)
+                  << result.threads << std::fixed << std::setprecision(3) << "  " << std::setw(8)
+                  << result.mrays_per_second << " Mrays/s  trace " << result.trace_seconds << "s  build "
+                  << result.build_seconds << "s" << std::endl;
+    }
+}
+
+// 每个结果占一行，便于作为基准读取
+void write_json(std::ostream &out, const bench_options &options, const std::vector<bench_result> &results)
+{
+    out << "{\n";
+    out << "  \"benchmark\": \"rt_bench\",\n";
+    out << "  \"config\": {\"image_width\": " << options.image_width
+        << ", \"samples_per_pixel\": " << options.samples_per_pixel << ", \"max_depth\": " << options.max_depth
+        << ", \"seed\": " << options.seed << ", \"warmup\": " << options.warmup
+        << ", \"repeat\": " << options.repeat
+        << ", \"real\": \"" << (sizeof(real) == sizeof(float) ? "float" : "double")
+#ifdef RT_SIMD_VEC3
+        << "\", \"simd_vec3\": true"
+#else
+        << "\", \"simd_vec3\": false"
+#endif
+        << ", \"packet_tracing\": " << (options.packet_tracing ? "true" : "false")
+        << ", \"wavefront\": " << (options.wavefront ? "true" : "false")
+        << ", \"light_sampling\": " << (options.light_sampling ? "true" : "false")
+        << ", \"sampler\": \"" << sampler_type_name(options.sampler) << "\""
+        << ", \"hardware_threads\": " << std::thread::hardware_concurrency() << "},\n";
+    out << "  \"results\": [\n";
+    out << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const bench_result &r = results[i];
+        char hash[20];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(r.image_hash));
+        out << "    {\"scene\": \"" << r.scene << "\", \"threads\": " << r.threads << ", \"width\": " << r.width
+            << ", \"height\": " << r.height << ", \"samples_per_pixel\": " << r.samples_per_pixel
+            << ", \"max_depth\": " << r.max_depth << ", \"rays\": " << r.rays
+            << ", \"config\": \"" << r.config << "\"" << ", \"mrays_per_second\": " << r.mrays_per_second
+            << ", \"best_mrays_per_second\": " << r.best_mrays_per_second << ", \"scene_seconds\": " << r.scene_seconds
+            << ", \"build_seconds\": " << r.build_seconds << ", \"trace_seconds\": " << r.trace_seconds
+            << ", \"output_seconds\": " << r.output_seconds << ", \"peak_rss_kb\": " << r.peak_rss_kb
+            << ", \"image_hash\": \"" << hash << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// 从JSON的一行中读取字段的值（只支持write_json写出的格式）
+bool json_field(const std::string &line, const std::string &key, std::string &value)
+{
+    std::string pattern = "\"" + key + "\": ";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return false;
+    pos += pattern.size();
+    if (pos < line.size() && line[pos] == '"')
+    {
+        size_t end = line.find('"', pos + 1);
+        value = line.substr(pos + 1, end - pos - 1);
+    }
+    else
+    {
+        size_t end = line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+    }
+    return true;
+}
+
+// compare_baseline的结果，同时作为进程的返回值
+enum class baseline_status
+{
+    ok = 0,
+    not_comparable = 1, // 基准文件无法读取，或渲染配置与本次不同
+    regression = 2,
+};
+
+/**
+ * @brief 与基准结果比较，按场景和线程数对应，渲染配置必须完全相同，比较中位数的速度
+ */
+baseline_status compare_baseline(const std::string &path, double tolerance, const std::vector<bench_result> &results)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "Cannot open baseline '" << path << "'" << std::endl;
+        return baseline_status::not_comparable;
+    }
+
+    struct baseline_entry
+    {
+        std::string config;
+        double mrays_per_second;
+        std::string image_hash;
+    };
+    std::map<std::pair<std::string, int>, baseline_entry> baseline;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::string scene, threads, mrays, config, hash;
+        if (json_field(line, "scene", scene) && json_field(line, "threads", threads) &&
+            json_field(line, "mrays_per_second", mrays))
+        {
+            json_field(line, "config", config);
+            json_field(line, "image_hash", hash);
+            baseline[{scene, std::atoi(threads.c_str())}] = {config, std::atof(mrays.c_str()), hash};
+        }
+    }
+
+    // 先检查配置，任何一项不同都不做比较，避免把配置差异误报为性能变化
+    bool comparable = true;
+    for (const bench_result &r : results)
+    {
+        auto it = baseline.find({r.scene, r.threads});
+        if (it == baseline.end() || it->second.config == r.config)
+            continue;
+        comparable = false;
+        std::cerr << "Baseline " << path << " was recorded with a different configuration for " << r.scene
+                  << " threads " << r.threads << ":\n  baseline: "
+                  << (it->second.config.empty() ? "(none)" : it->second.config) << "\n  current:  " << r.config
+                  << std::endl;
+    }
+    if (!comparable)
+        return baseline_status::not_comparable;
+
+    baseline_status status = baseline_status::ok;
+    std::cerr << "Baseline " << path << ":" << std::endl;
+    for (const bench_result &r : results)
+    {
+        auto it = baseline.find({r.scene, r.threads});
+        if (it == baseline.end())
+        {
+            std::cerr << "  " << r.scene << " threads " << r.threads << ": no baseline" << std::endl;
+            continue;
+        }
+        const baseline_entry &entry = it->second;
+        double ratio = entry.mrays_per_second > 0 ? r.mrays_per_second / entry.mrays_per_second : 0;
+        bool regressed = ratio < 1 - tolerance;
+        if (regressed)
+            status = baseline_status::regression;
+
+        char hash[20];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(r.image_hash));
+        std::cerr << "  " << std::left << std::setw(14) << r.scene << std::right << " threads " << std::setw(3)
+                  << r.threads << std::fixed << std::setprecision(3) << "  " << entry.mrays_per_second << " -> "
+                  << r.mrays_per_second << " Mrays/s (" << std::showpos << (ratio - 1) * 100 << std::noshowpos
+                  << "%)" << (regressed ? "  REGRESSION" : "") << (entry.image_hash != hash ? "  image changed" : "")
+                  << std::endl;
+    }
+    return status;
+}
+
+std::vector<int> parse_int_list(const std::string &value)
+{
+    std::vector<int> list;
+    std::istringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ','))
+        list.push_back(std::atoi(item.c_str()));
+    return list;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // --scene 场景名（可重复），--threads 逗号分隔的线程数列表，--width 图片宽度，--spp 每个像素的采样数，
+    // --depth 最大弹射次数，--seed 随机数种子，--warmup 预热次数，--repeat 计时渲染次数（取中位数），
+    // --packet/--wavefront/--lights 0|1 渲染方式，--sampler independent|sobol 采样器，
+    // --out 结果文件，--baseline 基准结果文件，--tolerance 允许的性能下降比例
+    bench_options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for '" << arg << "'" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--scene")
+        {
+            if (!find_builtin_scene(value.c_str()))
+            {
+                std::cerr << "Unknown scene '" << value << "'" << std::endl;
+                return 1;
+            }
+            options.scenes.push_back(value);
+        }
+        else if (arg == "--threads")
+            options.threads = parse_int_list(value);
+        else if (arg == "--width")
+            options.image_width = std::atoi(value.c_str());
+        else if (arg == "--spp")
+            options.samples_per_pixel = std::atoi(value.c_str());
+        else if (arg == "--depth")
+            options.max_depth = std::atoi(value.c_str());
+        else if (arg == "--seed")
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--warmup")
+            options.warmup = std::atoi(value.c_str());
+        else if (arg == "--repeat")
+            options.repeat = std::atoi(value.c_str());
+        else if (arg == "--packet")
+            options.packet_tracing = std::atoi(value.c_str()) != 0;
+        else if (arg == "--wavefront")
+            options.wavefront = std::atoi(value.c_str()) != 0;
+        else if (arg == "--lights")
+            options.light_sampling = std::atoi(value.c_str()) != 0;
+        else if (arg == "--sampler")
+        {
+            if (!parse_sampler_type(value, options.sampler))
+            {
+                std::cerr << "Unknown sampler '" << value << "'" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--out")
+            options.output_file = value;
+        else if (arg == "--baseline")
+            options.baseline_file = value;
+        else if (arg == "--tolerance")
+            options.tolerance = std::atof(value.c_str());
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--scene spheres|cornell_box|cornell_smoke|final_scene]... [--threads 1,2,4]"
+                      << " [--width 200] [--spp 16] [--depth n] [--seed 1] [--warmup 1] [--repeat 3]"
+                      << " [--packet 0|1] [--wavefront 0|1] [--lights 0|1] [--sampler independent|sobol]"
+                      << " [--out results.json]"
+                      << " [--baseline results.json] [--tolerance 0.05]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.scenes.empty())
+    {
+        for (const builtin_scene &scene : builtin_scenes)
+            options.scenes.push_back(scene.name);
+    }
+
+    std::vector<bench_result> results;
+    for (const std::string &name : options.scenes)
+        run_scene(*find_builtin_scene(name.c_str()), options, results);
+
+    if (options.output_file.empty())
+    {
+        write_json(std::cout, options, results);
+    }
+    else
+    {
+        std::ofstream out(options.output_file);
+        if (!out)
+        {
+            std::cerr << "Cannot write '" << options.output_file << "'" << std::endl;
+            return 1;
+        }
+        write_json(out, options, results);
+    }
+
+    if (!options.baseline_file.empty())
+        return int(compare_baseline(options.baseline_file, options.tolerance, results));
+    return 0;
+}
@@ -86,6 +86,22 @@ class rtw_image
         return bdata + y * bytes_per_scanline + x * bytes_per_pixel;
     }
 
+    /**
+     * @brief 像素(x, y)的线性空间浮点数据，依次为r、g、b，用于HDR图片
+     */
+    const float *float_pixel_data(int x, int y) const
+    {
+        static const float magenta[] = {1, 0, 1};
+
+        if (fdata == nullptr)
+            return magenta;
+
+        x = clamp(x, 0, image_width);
+        y = clamp(y, 0, image_height);
+
+        return fdata + (y * image_width + x) * bytes_per_pixel;
+    }
+
   private:
     /**
      * @brief 将给定值限制在[low, high)范围内
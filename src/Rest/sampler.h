@@ -0,0 +1,196 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <string>
+
+// 采样器类型，决定渲染时每个采样的各个维度取值的方式
+enum class sampler_type
+{
+    independent, // 每个维度都是独立的均匀随机数
+    sobol,       // Owen扰乱的Sobol序列（低差异序列）
+};
+
+// 按名称（independent、sobol）解析采样器类型，无法识别时返回false
+inline bool parse_sampler_type(const std::string &name, sampler_type &type)
+{
+    if (name == "independent")
+        type = sampler_type::independent;
+    else if (name == "sobol")
+        type = sampler_type::sobol;
+    else
+        return false;
+    return true;
+}
+
+inline const char *sampler_type_name(sampler_type type)
+{
+    return type == sampler_type::sobol ? "sobol" : "independent";
+}
+
+namespace sobol_detail
+{
+
+inline uint32_t reverse_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine-Karras置换：每一位只受更低位的影响
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+/**
+ * @brief 基于哈希的Owen扰乱（Burley 2020）：每一位只受更高位的影响，保持序列的分层性质
+ */
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+{
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+}
+
+inline uint32_t hash_combine(uint32_t seed, uint32_t value)
+{
+    return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+inline uint32_t hash(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return uint32_t(x);
+}
+
+// Sobol序列第1维按字节查表：生成矩阵是模2的Pascal矩阵，每个字节对结果的贡献预先计算
+struct sobol_dimension1_table
+{
+    uint32_t bytes[4][256];
+
+    sobol_dimension1_table()
+    {
+        uint32_t directions[32];
+        directions[0] = 1u << 31;
+        for (int k = 1; k < 32; ++k)
+            directions[k] = directions[k - 1] ^ (directions[k - 1] >> 1);
+
+        for (int b = 0; b < 4; ++b)
+        {
+            for (uint32_t value = 0; value < 256; ++value)
+            {
+                uint32_t result = 0;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    if (value & (1u << bit))
+                        result ^= directions[8 * b + bit];
+                }
+                bytes[b][value] = result;
+            }
+        }
+    }
+};
+
+inline const sobol_dimension1_table dimension1_table;
+
+// Sobol序列的前两个维度，第0维是van der Corput序列
+inline uint32_t sobol(uint32_t index, int dimension)
+{
+    if (dimension == 0)
+        return reverse_bits(index);
+    const sobol_dimension1_table &table = dimension1_table;
+    return table.bytes[0][index & 0xff] ^ table.bytes[1][(index >> 8) & 0xff] ^
+           table.bytes[2][(index >> 16) & 0xff] ^ table.bytes[3][index >> 24];
+}
+
+} // namespace sobol_detail
+
+/**
+ * @brief 一个像素内第index个采样的低差异序列，按维度依次取值
+ *
+ * 维度两两分组，每组是二维Sobol点：采样编号经过与组有关的Owen扰乱打乱顺序，各个坐标再分别做Owen扰乱，
+ * 因此任意一组维度在一个像素的所有采样上都是分层良好的点集，不同的组和不同的像素之间互不相关，维度数量没有上限
+ */
+class sobol_sequence
+{
+  public:
+    /**
+     * @param pixel_seed 由全局种子和像素编号得到的种子
+     * @param index 像素内的采样编号
+     */
+    void start(uint64_t pixel_seed, uint32_t index)
+    {
+        seed = sobol_detail::hash(pixel_seed);
+        this->index = index;
+        dimension = 0;
+        running = true;
+        cached_group = ~0u;
+    }
+
+    void stop()
+    {
+        running = false;
+    }
+
+    bool active() const
+    {
+        return running;
+    }
+
+    // 下一个维度，[0, 1)之间
+    double next_1d()
+    {
+        uint32_t group = dimension >> 1;
+        int axis = int(dimension & 1);
+        ++dimension;
+        return sample(group, axis);
+    }
+
+    // 下两个维度，从新的一组开始，保证两个值来自同一组二维点
+    void next_2d(double &u, double &v)
+    {
+        dimension += dimension & 1;
+        uint32_t group = dimension >> 1;
+        dimension += 2;
+        u = sample(group, 0);
+        v = sample(group, 1);
+    }
+
+  private:
+    uint32_t seed = 0;
+    uint32_t index = 0;
+    uint32_t dimension = 0;
+    bool running = false;
+    // 最近一次使用的组及其打乱后的采样编号，同一组的两个坐标只计算一次
+    uint32_t cached_group = ~0u;
+    uint32_t group_seed = 0;
+    uint32_t shuffled = 0;
+
+    double sample(uint32_t group, int axis)
+    {
+        if (group != cached_group)
+        {
+            cached_group = group;
+            group_seed = sobol_detail::hash_combine(seed, group);
+            shuffled = sobol_detail::nested_uniform_scramble(index, group_seed);
+        }
+        uint32_t x = sobol_detail::sobol(shuffled, axis);
+        x = sobol_detail::nested_uniform_scramble(x, sobol_detail::hash_combine(group_seed, uint32_t(axis) + 1));
+        return x * 0x1.0p-32;
+    }
+};
+
+#endif // !SAMPLER_H
@@ -0,0 +1,386 @@
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include "bvh.h"
+#include "bvh4.h"
+#include "camera.h"
+#include "constant_medium.h"
+#include "environment_map.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "mesh_cache.h"
+#include "mesh_loader.h"
+#include "quad.h"
+#include "sphere.h"
+#include "texture.h"
+#include "triangle_mesh.h"
+#include <fstream>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief 读取文本格式的场景描述，构建场景中的物体、材质、纹理并设置相机参数
+ *
+ * 每行一条语句，#之后为注释，名称中不能包含空白字符：
+ *   camera <参数名> <值> ...        参数名与camera的成员同名，向量参数依次给出三个分量
+ *   texture <名称> solid <r g b> | checker <scale> <偶数格纹理> <奇数格纹理> | image <文件> | noise <scale>
+ *   material <名称> lambertian <r g b> | lambertian_texture <纹理> | metal <r g b> <fuzz> | dielectric <折射率>
+ *                   | light <r g b> | light_texture <纹理> | isotropic <r g b>
+ *   sphere <中心> <半径> <材质>
+ *   moving_sphere <起点> <终点> <半径> <材质>
+ *   quad <Q> <u> <v> <材质>
+ *   box <顶点a> <顶点b> <材质>
+ *   mesh <OBJ或PLY文件> <材质>
+ *   accel bvh4 | bvh | flat_bvh | none       场景使用的加速结构，默认为bvh4
+ *   environment <图片文件> [强度]            经纬度格式的环境光（如HDR图片），代替相机的background
+ * 物体语句之后可以依次跟随变换：rotate_y <角度>、translate <偏移>、medium <密度> <r g b>（转为参与介质）
+ * 图片纹理、网格和环境光的文件路径为相对路径时，相对于场景文件所在的目录
+ *
+ * 出错时抛出std::runtime_error，信息中包含文件名和行号
+ * 设置cache_dir后网格连同其BVH缓存在该目录中，再次读取同一网格时直接映射缓存文件
+ */
+class scene_loader
+{
+  public:
+    scene_loader(hittable_list &world, camera &cam) : world(world), cam(cam)
+    {
+    }
+
+    void load_file(const std::string &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("cannot open scene file '" + path + "'");
+        load(in, path);
+    }
+
+    /**
+     * @brief 读取场景描述，所有语句读取完毕后按accel语句构建加速结构
+     *
+     * @param in 输入流
+     * @param name 场景名称，用于错误信息
+     */
+    void load(std::istream &in, const std::string &name)
+    {
+        source = name;
+        line_number = 0;
+        hittable_list objects;
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            ++line_number;
+            line = line.substr(0, line.find('#'));
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword))
+                continue;
+
+            if (keyword == "camera")
+                parse_camera(tokens);
+            else if (keyword == "texture")
+                parse_texture(tokens);
+            else if (keyword == "material")
+                parse_material(tokens);
+            else if (keyword == "accel")
+                accel = read_word(tokens, "acceleration structure");
+            else if (keyword == "environment")
+                parse_environment(tokens);
+            else
+                objects.add(parse_object(keyword, tokens));
+        }
+
+        if (objects.size() == 0)
+            throw std::runtime_error(source + ": scene has no objects");
+
+        if (accel == "bvh4")
+            world.add(make_shared<bvh4>(objects));
+        else if (accel == "bvh")
+            world.add(make_shared<bvh_node>(objects));
+        else if (accel == "flat_bvh")
+            world.add(make_shared<flat_bvh>(objects));
+        else if (accel == "none")
+            world.add(make_shared<hittable_list>(objects));
+        else
+            throw std::runtime_error(source + ": unknown acceleration structure '" + accel + "'");
+    }
+
+    // 网格缓存目录，为空时不使用缓存
+    void set_cache_dir(const std::string &dir)
+    {
+        cache_dir = dir;
+    }
+
+  private:
+    hittable_list &world;
+    camera &cam;
+
+    std::map<std::string, shared_ptr<texture>> textures;
+    std::map<std::string, shared_ptr<material>> materials;
+    std::string accel = "bvh4";
+    std::string cache_dir;
+
+    std::string source;
+    int line_number = 0;
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw std::runtime_error(source + ":" + std::to_string(line_number) + ": " + message);
+    }
+
+    std::string read_word(std::istream &tokens, const char *what) const
+    {
+        std::string word;
+        if (!(tokens >> word))
+            fail(std::string("expected ") + what);
+        return word;
+    }
+
+    double read_number(std::istream &tokens, const char *what) const
+    {
+        std::string word = read_word(tokens, what);
+        try
+        {
+            size_t used = 0;
+            double value = std::stod(word, &used);
+            if (used == word.size())
+                return value;
+        }
+        catch (const std::exception &)
+        {
+        }
+        fail(std::string("expected ") + what + ", got '" + word + "'");
+    }
+
+    vec3 read_vec3(std::istream &tokens, const char *what) const
+    {
+        double x = read_number(tokens, what);
+        double y = read_number(tokens, what);
+        double z = read_number(tokens, what);
+        return vec3(x, y, z);
+    }
+
+    shared_ptr<texture> find_texture(std::istream &tokens) const
+    {
+        std::string name = read_word(tokens, "texture name");
+        auto it = textures.find(name);
+        if (it == textures.end())
+            fail("unknown texture '" + name + "'");
+        return it->second;
+    }
+
+    shared_ptr<material> find_material(std::istream &tokens) const
+    {
+        std::string name = read_word(tokens, "material name");
+        auto it = materials.find(name);
+        if (it == materials.end())
+            fail("unknown material '" + name + "'");
+        return it->second;
+    }
+
+    // 相对路径相对于场景文件所在的目录
+    std::string resolve_path(const std::string &path) const
+    {
+        size_t slash = source.find_last_of('/');
+        if (path.empty() || path[0] == '/' || slash == std::string::npos)
+            return path;
+        return source.substr(0, slash + 1) + path;
+    }
+
+    void parse_camera(std::istream &tokens)
+    {
+        std::string key;
+        while (tokens >> key)
+        {
+            if (key == "aspect_ratio")
+                cam.aspect_ratio = read_number(tokens, "aspect ratio");
+            else if (key == "image_width")
+                cam.image_width = int(read_number(tokens, "image width"));
+            else if (key == "samples_per_pixel")
+                cam.samples_per_pixel = int(read_number(tokens, "samples per pixel"));
+            else if (key == "max_depth")
+                cam.max_depth = int(read_number(tokens, "max depth"));
+            else if (key == "vfov")
+                cam.vfov = read_number(tokens, "vertical fov");
+            else if (key == "background")
+                cam.background = read_vec3(tokens, "background color");
+            else if (key == "lookfrom")
+                cam.lookfrom = read_vec3(tokens, "camera position");
+            else if (key == "lookat")
+                cam.lookat = read_vec3(tokens, "look-at point");
+            else if (key == "vup")
+                cam.vup = read_vec3(tokens, "up vector");
+            else if (key == "defocus_angle")
+                cam.defocus_angle = read_number(tokens, "defocus angle");
+            else if (key == "focus_dis")
+                cam.focus_dis = read_number(tokens, "focus distance");
+            else
+                fail("unknown camera parameter '" + key + "'");
+        }
+    }
+
+    void parse_environment(std::istream &tokens)
+    {
+        std::string path = resolve_path(read_word(tokens, "environment image"));
+        double scale = 1;
+        if (!(tokens >> std::ws).eof())
+            scale = read_number(tokens, "environment scale");
+
+        auto environment = make_shared<environment_map>(path.c_str(), scale);
+        if (!environment->valid())
+            fail("cannot load environment image '" + path + "'");
+        cam.environment = environment;
+    }
+
+    void parse_texture(std::istream &tokens)
+    {
+        std::string name = read_word(tokens, "texture name");
+        std::string type = read_word(tokens, "texture type");
+
+        shared_ptr<texture> tex;
+        if (type == "solid")
+        {
+            tex = make_shared<solid_color>(read_vec3(tokens, "color"));
+        }
+        else if (type == "checker")
+        {
+            double scale = read_number(tokens, "checker scale");
+            shared_ptr<texture> even = find_texture(tokens);
+            tex = make_shared<checker_texture>(scale, even, find_texture(tokens));
+        }
+        else if (type == "image")
+        {
+            std::string path = resolve_path(read_word(tokens, "image file"));
+            tex = make_shared<image_texture>(path.c_str());
+        }
+        else if (type == "noise")
+        {
+            tex = make_shared<noise_texture>(read_number(tokens, "noise scale"));
+        }
+        else
+        {
+            fail("unknown texture type '" + type + "'");
+        }
+        textures[name] = tex;
+    }
+
+    void parse_material(std::istream &tokens)
+    {
+        std::string name = read_word(tokens, "material name");
+        std::string type = read_word(tokens, "material type");
+
+        shared_ptr<material> mat;
+        if (type == "lambertian")
+        {
+            mat = make_shared<lambertian>(read_vec3(tokens, "albedo"));
+        }
+        else if (type == "lambertian_texture")
+        {
+            mat = make_shared<lambertian>(find_texture(tokens));
+        }
+        else if (type == "metal")
+        {
+            color albedo = read_vec3(tokens, "albedo");
+            mat = make_shared<metal>(albedo, read_number(tokens, "fuzz"));
+        }
+        else if (type == "dielectric")
+        {
+            mat = make_shared<dielectric>(read_number(tokens, "refraction index"));
+        }
+        else if (type == "light")
+        {
+            mat = make_shared<diffuse_light>(read_vec3(tokens, "emitted color"));
+        }
+        else if (type == "light_texture")
+        {
+            mat = make_shared<diffuse_light>(find_texture(tokens));
+        }
+        else if (type == "isotropic")
+        {
+            mat = make_shared<isotropic>(read_vec3(tokens, "albedo"));
+        }
+        else
+        {
+            fail("unknown material type '" + type + "'");
+        }
+        materials[name] = mat;
+    }
+
+    shared_ptr<hittable> parse_object(const std::string &type, std::istream &tokens)
+    {
+        shared_ptr<hittable> object;
+        if (type == "sphere")
+        {
+            point3 center = read_vec3(tokens, "sphere center");
+            double radius = read_number(tokens, "sphere radius");
+            object = make_shared<sphere>(center, radius, find_material(tokens));
+        }
+        else if (type == "moving_sphere")
+        {
+            point3 start = read_vec3(tokens, "sphere start");
+            point3 end = read_vec3(tokens, "sphere end");
+            double radius = read_number(tokens, "sphere radius");
+            object = make_shared<sphere>(start, end, radius, find_material(tokens));
+        }
+        else if (type == "quad")
+        {
+            point3 Q = read_vec3(tokens, "quad corner");
+            vec3 u = read_vec3(tokens, "quad edge");
+            vec3 v = read_vec3(tokens, "quad edge");
+            object = make_shared<quad>(Q, u, v, find_material(tokens));
+        }
+        else if (type == "box")
+        {
+            point3 a = read_vec3(tokens, "box corner");
+            point3 b = read_vec3(tokens, "box corner");
+            object = box(a, b, find_material(tokens));
+        }
+        else if (type == "mesh")
+        {
+            std::string path = resolve_path(read_word(tokens, "mesh file"));
+            shared_ptr<material> mat = find_material(tokens);
+            try
+            {
+                object = load_mesh_cached(path, mat, cache_dir);
+            }
+            catch (const std::runtime_error &e)
+            {
+                fail(e.what());
+            }
+        }
+        else
+        {
+            fail("unknown statement '" + type + "'");
+        }
+
+        // 依次应用变换
+        std::string modifier;
+        while (tokens >> modifier)
+        {
+            if (modifier == "rotate_y")
+            {
+                object = make_shared<rotate_y>(object, read_number(tokens, "rotation angle"));
+            }
+            else if (modifier == "translate")
+            {
+                object = make_shared<translate>(object, read_vec3(tokens, "offset"));
+            }
+            else if (modifier == "medium")
+            {
+                double density = read_number(tokens, "medium density");
+                object = make_shared<constant_medium>(object, density, read_vec3(tokens, "medium albedo"));
+            }
+            else
+            {
+                fail("unknown object modifier '" + modifier + "'");
+            }
+        }
+        return object;
+    }
+};
+
+#endif // !SCENE_LOADER_H
@@ -10,7 +10,7 @@
 class sphere : public hittable
 {
   public:
-    sphere(const point3 &static_center, double radius, shared_ptr<material> mat)
+    sphere(const point3 &static_center, real radius, shared_ptr<material> mat)
         : move(static_center, vec3(0, 0, 0)), radius(std::fmax(0, radius)), mat(mat)
     {
         // 球体被包围在一个正方体中，rvec表示球心到正方体右上前方的顶点向量
@@ -18,7 +18,7 @@ class sphere : public hittable
         bbox = aabb(static_center - rvec, static_center + rvec);
     }
 
-    sphere(const point3 &start, const point3 &end, double radius, shared_ptr<material> mat)
+    sphere(const point3 &start, const point3 &end, real radius, shared_ptr<material> mat)
         : move(start, end - start), radius(std::fmax(0, radius)), mat(mat)
     {
         // 球体被包围在一个正方体中，rvec表示球心到正方体右上前方的顶点向量
@@ -33,40 +33,34 @@ class sphere : public hittable
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
-        point3 current_center = move.at(r.time());
-        vec3 oc = current_center - r.origin();
-        double a = r.direction().length_squared();
-        // double b = -2.0 * dot(r.direction(), oc);
-        double h = dot(r.direction(), oc);
-        double c = oc.length_squared() - radius * radius;
-
-        double discriminant = h * h - a * c;
-        if (discriminant < 0)
+        real root;
+        if (!find_root(r, ray_t, move.at(r.time()), root))
             return false;
 
-        double sqrt_dis = std::sqrt(discriminant);
-        double root = (h - sqrt_dis) / a;
+        // 交点可能被之后更近的交点替换，法向量和纹理坐标（acos、atan2）留到finish_hit中计算
+        rec.t = root;
+        rec.pending = this;
 
-        // 只使用一个变量记录根
-        // ray_tmax < root这种情况会发生吗？个人觉得不会，因为a恒正
-        //! 注意，不能使用contains，必须用surrounds，因为交点必须在(0,
-        //! +infity)之间，不能等于二者任何一个，否则在求交点时会无限递归
-        if (!ray_t.surrounds(root))
-        {
-            root = (h + sqrt_dis) / a;
-            if (!ray_t.surrounds(root))
-                return false;
-        }
+        return true;
+    }
 
-        rec.t = root;
+    void finish_hit(const ray &r, hit_record &rec) const override
+    {
+        point3 current_center = move.at(r.time());
         rec.p = r.at(rec.t);
 
         vec3 outward_normal = (rec.p - current_center) / radius;
         rec.set_face_normal(r, outward_normal);
         get_uv(outward_normal, rec.u, rec.v);
-        rec.mat = mat;
+        rec.mat = mat.get();
+        rec.object = this;
+    }
 
-        return true;
+    // 只需判断是否相交，跳过法向量和纹理坐标（acos、atan2）的计算
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        real root;
+        return find_root(r, ray_t, move.at(r.time()), root);
     }
 
     aabb bounding_box() const override
@@ -74,15 +68,107 @@ class sphere : public hittable
         return bbox;
     }
 
+    // 静止的发光球体可以作为光源采样
+    void collect_lights(std::vector<const hittable *> &lights) const override
+    {
+        if (mat && mat->kind() == material_kind::diffuse_light && move.direction().length_squared() == 0 &&
+            radius > 0)
+            lights.push_back(this);
+    }
+
+    /**
+     * @brief 在从origin看到的球冠对应的锥体内均匀采样方向，取该方向与球面最近的交点
+     * origin在球内时无法采样
+     */
+    bool sample_light(const point3 &origin, light_sample &sample) const override
+    {
+        const point3 &center = move.origin();
+        vec3 to_center = center - origin;
+        real distance_squared = to_center.length_squared();
+        real one_minus_cos_max = cone_one_minus_cos(distance_squared);
+        if (one_minus_cos_max <= 0)
+            return false;
+
+        // 以指向球心的方向为w轴建立局部坐标系
+        real distance = std::sqrt(distance_squared);
+        vec3 w = to_center / distance;
+        vec3 a = std::fabs(w.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        vec3 v = unit(cross(w, a));
+        vec3 u = cross(w, v);
+
+        // 1 - cos_theta在[0, 1 - cos_max]内均匀分布，用它计算sin_theta避免相减损失精度
+        double u1, u2;
+        random_double_2d(u1, u2);
+        real one_minus_cos = u1 * one_minus_cos_max;
+        real cos_theta = 1 - one_minus_cos;
+        real sin2_theta = one_minus_cos * (2 - one_minus_cos);
+        real sin_theta = std::sqrt(sin2_theta);
+        real phi = 2 * pi * u2;
+        vec3 direction = sin_theta * std::cos(phi) * u + sin_theta * std::sin(phi) * v + cos_theta * w;
+
+        real t = distance * cos_theta - std::sqrt(std::fmax(0, radius * radius - distance_squared * sin2_theta));
+        sample.p = origin + t * direction;
+        get_uv((sample.p - center) / radius, sample.u, sample.v);
+        sample.pdf = 1 / (2 * pi * one_minus_cos_max);
+        sample.mat = mat.get();
+        return true;
+    }
+
+    real light_pdf(const point3 &origin, const hit_record &rec) const override
+    {
+        real one_minus_cos_max = cone_one_minus_cos((move.origin() - origin).length_squared());
+        return one_minus_cos_max > 0 ? 1 / (2 * pi * one_minus_cos_max) : 0;
+    }
+
   private:
     // point3 center;
     // 添加运动属性
     ray move;
-    double radius;
+    real radius;
     shared_ptr<material> mat;
     aabb bbox;
 
-    static void get_uv(const point3 &p, double &u, double &v)
+    /**
+     * @brief 求光线与球心在current_center的球面在ray_t内最近的交点
+     */
+    bool find_root(const ray &r, interval ray_t, const point3 &current_center, real &root) const
+    {
+        vec3 oc = current_center - r.origin();
+        real a = r.direction().length_squared();
+        // real b = -2.0 * dot(r.direction(), oc);
+        real h = dot(r.direction(), oc);
+        real c = oc.length_squared() - radius * radius;
+
+        real discriminant = h * h - a * c;
+        if (discriminant < 0)
+            return false;
+
+        real sqrt_dis = std::sqrt(discriminant);
+        root = (h - sqrt_dis) / a;
+
+        // 只使用一个变量记录根
+        // ray_tmax < root这种情况会发生吗？个人觉得不会，因为a恒正
+        //! 注意，不能使用contains，必须用surrounds，因为交点必须在(0,
+        //! +infity)之间，不能等于二者任何一个，否则在求交点时会无限递归
+        if (!ray_t.surrounds(root))
+        {
+            root = (h + sqrt_dis) / a;
+            if (!ray_t.surrounds(root))
+                return false;
+        }
+        return true;
+    }
+
+    // 距球心distance_squared处看到的球冠半角的1 - cos，在球内时返回0
+    real cone_one_minus_cos(real distance_squared) const
+    {
+        real sin2_max = radius * radius / distance_squared;
+        if (sin2_max >= 1)
+            return 0;
+        return sin2_max / (1 + std::sqrt(1 - sin2_max));
+    }
+
+    static void get_uv(const point3 &p, real &u, real &v)
     {
         // p: a given point on the sphere of radius one, centered at the origin.
         // u: returned value [0,1] of angle around the Y axis from X=-1.
@@ -92,8 +178,8 @@ class sphere : public hittable
         //     <0 0 1> yields <0.25 0.50>       < 0  0 -1> yields <0.75 0.50>
         // 这种方式计算出来的结果，u从[0, 1]表示从左到右，
         //! v从[1,0]表示从上到下!!!
-        double theta = std::acos(-p.y());
-        double phi = std::atan2(-p.z(), p.x()) + pi;
+        real theta = std::acos(-p.y());
+        real phi = std::atan2(-p.z(), p.x()) + pi;
 
         u = phi / (2 * pi);
         v = theta / pi;
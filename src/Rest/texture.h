@@ -1,9 +1,9 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
-#include "NextWeek/interval.h"
-#include "NextWeek/perlin.h"
-#include "NextWeek/rtw_stb_image.h"
+#include "interval.h"
+#include "perlin.h"
+#include "rtw_stb_image.h"
 #include "color.h"
 #include "global.h"
 #include "vec3.h"
@@ -14,7 +14,7 @@ class texture
   public:
     virtual ~texture() = default;
 
-    virtual color value(double u, double v, const point3 &p) const = 0;
+    virtual color value(real u, real v, const point3 &p) const = 0;
 };
 
 class solid_color : public texture
@@ -24,11 +24,11 @@ class solid_color : public texture
     {
     }
 
-    solid_color(double red, double green, double blue) : albedo(color(red, green, blue))
+    solid_color(real red, real green, real blue) : albedo(color(red, green, blue))
     {
     }
 
-    color value(double u, double v, const point3 &p) const override
+    color value(real u, real v, const point3 &p) const override
     {
         return albedo;
     }
@@ -40,17 +40,17 @@ class solid_color : public texture
 class checker_texture : public texture
 {
   public:
-    checker_texture(double scale, shared_ptr<texture> even_tex, shared_ptr<texture> odd_tex)
+    checker_texture(real scale, shared_ptr<texture> even_tex, shared_ptr<texture> odd_tex)
         : inv_scale(1.0 / scale), even_tex(even_tex), odd_tex(odd_tex)
     {
     }
 
-    checker_texture(double scale, const color &c1, const color &c2)
+    checker_texture(real scale, const color &c1, const color &c2)
         : checker_texture(scale, make_shared<solid_color>(c1), make_shared<solid_color>(c2))
     {
     }
 
-    color value(double u, double v, const point3 &p) const override
+    color value(real u, real v, const point3 &p) const override
     {
         int x_int = int(std::floor(inv_scale * p.x()));
         int y_int = int(std::floor(inv_scale * p.y()));
@@ -62,7 +62,7 @@ class checker_texture : public texture
     }
 
   private:
-    double inv_scale;
+    real inv_scale;
     shared_ptr<texture> even_tex, odd_tex;
 };
 
@@ -73,7 +73,7 @@ class image_texture : public texture
     {
     }
 
-    color value(double u, double v, const point3 &p) const override
+    color value(real u, real v, const point3 &p) const override
     {
         if (image.height() <= 0)
             return color(0, 1, 1);
@@ -86,7 +86,7 @@ class image_texture : public texture
         int j = int(v * image.height());
         auto pixel = image.pixel_data(i, j);
 
-        double color_scale = 1.0 / 255.0;
+        real color_scale = 1.0 / 255.0;
         return color_scale * color(pixel[0], pixel[1], pixel[2]);
     }
 
@@ -97,10 +97,10 @@ class image_texture : public texture
 class noise_texture : public texture
 {
   public:
-    noise_texture(double scale) : scale(scale)
+    noise_texture(real scale) : scale(scale)
     {
     }
-    color value(double u, double v, const point3 &p) const override
+    color value(real u, real v, const point3 &p) const override
     {
         // return color(1, 1, 1) * 0.5 * (noise.turb(p, 7));
         return color(1, 1, 1) * 0.5 * (1.0 + std::sin(scale * p.z() + 10 * noise.turb(p, 7)));
@@ -108,7 +108,7 @@ class noise_texture : public texture
 
   private:
     perlin noise;
-    double scale;
+    real scale;
 };
 
 #endif // !TEXTURE_H
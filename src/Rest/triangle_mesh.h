@@ -0,0 +1,704 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "global.h"
+#include "hittable.h"
+#include "mapped_file.h"
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 三角形网格的数据：共享的顶点属性数组和每个三角形三个角的索引
+ * 位置、法线、纹理坐标各自使用独立的索引（与OBJ一致），法线和纹理坐标的索引数组为空表示网格没有该属性，
+ * 某个角的索引为-1表示该角没有该属性
+ */
+struct mesh_data
+{
+    std::vector<point3> positions;
+    std::vector<vec3> normals;
+    std::vector<real> uvs; // 每个纹理坐标两个分量
+
+    std::vector<int32_t> position_indices; // 每三个一组
+    std::vector<int32_t> normal_indices;
+    std::vector<int32_t> uv_indices;
+
+    size_t triangle_count() const
+    {
+        return position_indices.size() / 3;
+    }
+
+    /**
+     * @brief 检查索引是否越界，不合法时抛出std::runtime_error
+     */
+    void validate() const
+    {
+        if (position_indices.size() % 3 != 0)
+            throw std::runtime_error("mesh index count is not a multiple of 3");
+        check_indices(position_indices, positions.size(), false, "position");
+        check_indices(normal_indices, normals.size(), true, "normal");
+        check_indices(uv_indices, uvs.size() / 2, true, "texture coordinate");
+    }
+
+  private:
+    void check_indices(const std::vector<int32_t> &indices, size_t count, bool optional, const char *what) const
+    {
+        if (optional && indices.empty())
+            return;
+        if (indices.size() != position_indices.size())
+            throw std::runtime_error(std::string("mesh has a wrong number of ") + what + " indices");
+        for (int32_t index : indices)
+        {
+            if ((index < 0 && !(optional && index == -1)) || index >= int64_t(count))
+                throw std::runtime_error(std::string("mesh ") + what + " index out of range");
+        }
+    }
+};
+
+/**
+ * @brief 带索引的三角形网格，所有三角形共享顶点数组，网格内部使用自己的线性BVH，
+ * 三角形不单独分配对象，整个网格作为一个物体放入场景的bvh_node或bvh4中
+ * 与三角形求交使用Möller–Trumbore算法
+ * 网格数据和BVH可以保存为二进制缓存文件，之后通过mmap直接读取，不需要解析和重新构建
+ */
+class triangle_mesh : public hittable
+{
+  public:
+    triangle_mesh(mesh_data data, shared_ptr<material> mat) : mesh(std::move(data)), mat(mat)
+    {
+        mesh.validate();
+        // 构建BVH时通过arrays访问顶点
+        bind_arrays();
+        build();
+        bind_arrays();
+    }
+
+    /**
+     * @brief 将网格数据和构建好的BVH写入二进制缓存文件，各数组按64字节对齐，读取时直接映射使用
+     *
+     * @param path 缓存文件路径
+     * @param key 输入数据的哈希，读取时用于校验
+     * @return 是否写入成功
+     */
+    bool save_cache(const std::string &path, uint64_t key) const
+    {
+        cache_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, cache_magic, sizeof(header.magic));
+        header.key = key;
+        header.real_size = sizeof(real);
+        header.vec3_size = sizeof(vec3);
+        header.node_size = sizeof(linear_bvh_node);
+        header.tree_depth = tree_depth;
+        const interval *axes[3] = {&bbox.x, &bbox.y, &bbox.z};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            header.bbox[2 * axis] = axes[axis]->min;
+            header.bbox[2 * axis + 1] = axes[axis]->max;
+        }
+
+        const void *data[array_count] = {arrays.positions,        arrays.normals,    arrays.uvs,
+                                         arrays.position_indices, arrays.normal_indices, arrays.uv_indices,
+                                         arrays.nodes,            arrays.triangles};
+        header.count[positions_array] = arrays.position_count;
+        header.count[normals_array] = arrays.normal_count;
+        header.count[uvs_array] = arrays.uv_count;
+        header.count[position_indices_array] = 3 * arrays.triangle_count;
+        header.count[normal_indices_array] = arrays.normal_indices ? 3 * arrays.triangle_count : 0;
+        header.count[uv_indices_array] = arrays.uv_indices ? 3 * arrays.triangle_count : 0;
+        header.count[nodes_array] = arrays.node_count;
+        header.count[triangles_array] = arrays.triangle_count;
+
+        uint64_t offset = align_offset(sizeof(header));
+        for (int a = 0; a < array_count; ++a)
+        {
+            header.offset[a] = offset;
+            offset = align_offset(offset + header.count[a] * element_size(a));
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        uint64_t written = sizeof(header);
+        static const char zeros[cache_alignment] = {};
+        for (int a = 0; a < array_count; ++a)
+        {
+            out.write(zeros, header.offset[a] - written);
+            out.write(static_cast<const char *>(data[a]), header.count[a] * element_size(a));
+            written = header.offset[a] + header.count[a] * element_size(a);
+        }
+        out.write(zeros, offset - written);
+        return bool(out);
+    }
+
+    /**
+     * @brief 映射save_cache写入的缓存文件，不做任何解析和构建，数组直接指向映射的内存
+     *
+     * @param path 缓存文件路径
+     * @param key 输入数据的哈希
+     * @param mat 网格的材质
+     * @return 文件不存在、损坏、哈希或类型大小不一致时返回nullptr
+     */
+    static shared_ptr<triangle_mesh> load_cache(const std::string &path, uint64_t key, shared_ptr<material> mat)
+    {
+        auto file = std::make_shared<mapped_file>();
+        if (!file->open(path) || file->size() < sizeof(cache_header))
+            return nullptr;
+
+        cache_header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, cache_magic, sizeof(header.magic)) != 0 || header.key != key ||
+            header.real_size != sizeof(real) || header.vec3_size != sizeof(vec3) ||
+            header.node_size != sizeof(linear_bvh_node))
+            return nullptr;
+        for (int a = 0; a < array_count; ++a)
+        {
+            if (header.offset[a] % cache_alignment != 0 || header.offset[a] > file->size() ||
+                header.count[a] > (file->size() - header.offset[a]) / element_size(a))
+                return nullptr;
+        }
+        uint64_t index_count = header.count[position_indices_array];
+        if (index_count % 3 != 0 || header.count[triangles_array] != index_count / 3 ||
+            (header.count[normal_indices_array] != 0 && header.count[normal_indices_array] != index_count) ||
+            (header.count[uv_indices_array] != 0 && header.count[uv_indices_array] != index_count))
+            return nullptr;
+
+        shared_ptr<triangle_mesh> mesh(new triangle_mesh(mat));
+        mesh->mapping = file;
+        mesh->tree_depth = header.tree_depth;
+        mesh->bbox = aabb(interval(header.bbox[0], header.bbox[1]), interval(header.bbox[2], header.bbox[3]),
+                          interval(header.bbox[4], header.bbox[5]));
+
+        auto at = [&](int a) -> const void * {
+            return header.count[a] == 0 ? nullptr : file->data() + header.offset[a];
+        };
+        mesh_arrays &arrays = mesh->arrays;
+        arrays.positions = static_cast<const point3 *>(at(positions_array));
+        arrays.normals = static_cast<const vec3 *>(at(normals_array));
+        arrays.uvs = static_cast<const real *>(at(uvs_array));
+        arrays.position_indices = static_cast<const int32_t *>(at(position_indices_array));
+        arrays.normal_indices = static_cast<const int32_t *>(at(normal_indices_array));
+        arrays.uv_indices = static_cast<const int32_t *>(at(uv_indices_array));
+        arrays.nodes = static_cast<const linear_bvh_node *>(at(nodes_array));
+        arrays.triangles = static_cast<const int32_t *>(at(triangles_array));
+        arrays.position_count = header.count[positions_array];
+        arrays.normal_count = header.count[normals_array];
+        arrays.uv_count = header.count[uvs_array];
+        arrays.node_count = header.count[nodes_array];
+        arrays.triangle_count = header.count[triangles_array];
+        if (!check_cache_arrays(arrays, mesh->tree_depth))
+            return nullptr;
+        return mesh;
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        if (arrays.node_count == 0)
+            return false;
+
+        const point3 &orig = r.origin();
+        const vec3 &dir = r.direction();
+        const double inv_dir[3] = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+        const bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+        int hit_triangle = -1;
+        real hit_u = 0, hit_v = 0;
+
+        int local_stack[max_stack_depth];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (tree_depth > max_stack_depth)
+        {
+            heap_stack.resize(tree_depth);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        int current = 0;
+
+        while (true)
+        {
+            const linear_bvh_node &node = arrays.nodes[current];
+            if (hit_bounds(node, orig, inv_dir, dir_is_neg, ray_t))
+            {
+                if (node.primitive_num > 0)
+                {
+                    for (int i = 0; i < node.primitive_num; ++i)
+                    {
+                        int triangle = arrays.triangles[node.offset + i];
+                        real t, u, v;
+                        if (intersect(triangle, r, ray_t, t, u, v))
+                        {
+                            // 只记录最近的三角形，交点属性在场景中最近的交点确定后计算一次
+                            ray_t.max = t;
+                            hit_triangle = triangle;
+                            hit_u = u;
+                            hit_v = v;
+                        }
+                    }
+                    if (stack_size == 0)
+                        break;
+                    current = to_visit[--stack_size];
+                }
+                else if (dir_is_neg[node.axis])
+                {
+                    to_visit[stack_size++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    to_visit[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+            else
+            {
+                if (stack_size == 0)
+                    break;
+                current = to_visit[--stack_size];
+            }
+        }
+
+        if (hit_triangle < 0)
+            return false;
+
+        // 网格的交点仍可能被场景中更近的交点替换，只记录三角形和重心坐标
+        rec.t = ray_t.max;
+        rec.u = hit_u;
+        rec.v = hit_v;
+        rec.primitive = hit_triangle;
+        rec.pending = this;
+        return true;
+    }
+
+    void finish_hit(const ray &r, hit_record &rec) const override
+    {
+        fill_record(rec.primitive, r, rec.t, rec.u, rec.v, rec);
+    }
+
+    /**
+     * @brief 找到任意一个相交的三角形后立即返回，不计算交点属性
+     */
+    bool occluded(const ray &r, interval ray_t) const override
+    {
+        if (arrays.node_count == 0)
+            return false;
+
+        const point3 &orig = r.origin();
+        const vec3 &dir = r.direction();
+        const double inv_dir[3] = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+        const bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+        int local_stack[max_stack_depth];
+        std::vector<int> heap_stack;
+        int *to_visit = local_stack;
+        if (tree_depth > max_stack_depth)
+        {
+            heap_stack.resize(tree_depth);
+            to_visit = heap_stack.data();
+        }
+        int stack_size = 0;
+        int current = 0;
+
+        while (true)
+        {
+            const linear_bvh_node &node = arrays.nodes[current];
+            if (hit_bounds(node, orig, inv_dir, dir_is_neg, ray_t))
+            {
+                if (node.primitive_num > 0)
+                {
+                    for (int i = 0; i < node.primitive_num; ++i)
+                    {
+                        real t, u, v;
+                        if (intersect(arrays.triangles[node.offset + i], r, ray_t, t, u, v))
+                            return true;
+                    }
+                    if (stack_size == 0)
+                        break;
+                    current = to_visit[--stack_size];
+                }
+                else if (dir_is_neg[node.axis])
+                {
+                    to_visit[stack_size++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    to_visit[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            }
+            else
+            {
+                if (stack_size == 0)
+                    break;
+                current = to_visit[--stack_size];
+            }
+        }
+
+        return false;
+    }
+
+    aabb bounding_box() const override
+    {
+        return bbox;
+    }
+
+    size_t triangle_count() const
+    {
+        return arrays.triangle_count;
+    }
+
+  private:
+    // 构建BVH时每个三角形的bbox和质心
+    struct mesh_primitive
+    {
+        aabb bbox;
+        point3 centroid;
+        int32_t triangle;
+    };
+
+    // 求交时使用的数组，指向自己持有的mesh、nodes、triangles，或者缓存文件映射的内存
+    struct mesh_arrays
+    {
+        const point3 *positions = nullptr;
+        const vec3 *normals = nullptr;
+        const real *uvs = nullptr;
+        const int32_t *position_indices = nullptr;
+        const int32_t *normal_indices = nullptr; // 为nullptr表示没有法线
+        const int32_t *uv_indices = nullptr;     // 为nullptr表示没有纹理坐标
+        const linear_bvh_node *nodes = nullptr;
+        const int32_t *triangles = nullptr;
+        size_t position_count = 0, normal_count = 0, uv_count = 0;
+        size_t node_count = 0, triangle_count = 0;
+    };
+
+    // 缓存文件中数组的顺序
+    enum cache_array
+    {
+        positions_array,
+        normals_array,
+        uvs_array,
+        position_indices_array,
+        normal_indices_array,
+        uv_indices_array,
+        nodes_array,
+        triangles_array,
+        array_count,
+    };
+
+    // 缓存文件头，之后是按64字节对齐的各个数组
+    struct cache_header
+    {
+        char magic[8];
+        uint64_t key;       // 输入数据的哈希
+        uint32_t real_size; // 以下三个大小不一致时（不同的编译选项）缓存失效
+        uint32_t vec3_size;
+        uint32_t node_size;
+        int32_t tree_depth;
+        double bbox[6];
+        uint64_t count[array_count];  // 各数组的元素个数
+        uint64_t offset[array_count]; // 各数组在文件中的偏移
+    };
+
+    static constexpr char cache_magic[8] = {'R', 'T', 'M', 'E', 'S', 'H', '0', '1'};
+    static constexpr uint64_t cache_alignment = 64;
+    static constexpr int max_stack_depth = 64;
+    static constexpr size_t max_leaf_size = 4;
+
+    mesh_data mesh;
+    shared_ptr<material> mat;
+    std::vector<linear_bvh_node> nodes;
+    std::vector<int32_t> triangles; // 按叶子顺序排列的三角形编号
+    shared_ptr<mapped_file> mapping;
+    mesh_arrays arrays;
+    aabb bbox;
+    int tree_depth = 0;
+
+    // 从缓存读取时使用，数组由load_cache设置
+    explicit triangle_mesh(shared_ptr<material> mat) : mat(mat)
+    {
+    }
+
+    void bind_arrays()
+    {
+        arrays.positions = mesh.positions.data();
+        arrays.normals = mesh.normals.empty() ? nullptr : mesh.normals.data();
+        arrays.uvs = mesh.uvs.empty() ? nullptr : mesh.uvs.data();
+        arrays.position_indices = mesh.position_indices.data();
+        arrays.normal_indices = mesh.normal_indices.empty() ? nullptr : mesh.normal_indices.data();
+        arrays.uv_indices = mesh.uv_indices.empty() ? nullptr : mesh.uv_indices.data();
+        arrays.nodes = nodes.data();
+        arrays.triangles = triangles.data();
+        arrays.position_count = mesh.positions.size();
+        arrays.normal_count = mesh.normals.size();
+        arrays.uv_count = mesh.uvs.size();
+        arrays.node_count = nodes.size();
+        arrays.triangle_count = mesh.triangle_count();
+    }
+
+    /**
+     * @brief 检查缓存文件中的索引和BVH节点是否越界，对应mesh_data::validate对解析得到的网格的检查，
+     * 文件头一致但内容损坏或过期的缓存不能通过检查，求交时不再需要判断越界
+     */
+    static bool check_cache_arrays(const mesh_arrays &arrays, int tree_depth)
+    {
+        auto indices_in_range = [&](const int32_t *indices, size_t count, bool optional) {
+            if (!indices)
+                return optional || arrays.triangle_count == 0;
+            for (size_t i = 0; i < 3 * arrays.triangle_count; ++i)
+            {
+                if (optional && indices[i] == -1)
+                    continue;
+                if (indices[i] < 0 || uint64_t(indices[i]) >= count)
+                    return false;
+            }
+            return true;
+        };
+        if (arrays.triangle_count > size_t(INT32_MAX) / 3 ||
+            !indices_in_range(arrays.position_indices, arrays.position_count, false) ||
+            !indices_in_range(arrays.normal_indices, arrays.normal_count, true) ||
+            !indices_in_range(arrays.uv_indices, arrays.uv_count / 2, true))
+            return false;
+
+        for (size_t i = 0; i < arrays.triangle_count; ++i)
+        {
+            if (arrays.triangles[i] < 0 || size_t(arrays.triangles[i]) >= arrays.triangle_count)
+                return false;
+        }
+
+        // 节点按深度优先顺序存储，孩子的下标总是大于父节点，从后往前计算每个子树的深度，
+        // 根节点的深度不超过文件头记录的tree_depth时遍历栈不会溢出
+        if (arrays.node_count > size_t(INT32_MAX))
+            return false;
+        std::vector<int> depth(arrays.node_count);
+        for (size_t i = arrays.node_count; i-- > 0;)
+        {
+            const linear_bvh_node &node = arrays.nodes[i];
+            if (node.primitive_num > 0)
+            {
+                if (node.offset < 0 || uint64_t(node.offset) + node.primitive_num > arrays.triangle_count)
+                    return false;
+                depth[i] = 1;
+            }
+            else
+            {
+                if (node.axis > 2 || node.offset <= int64_t(i) + 1 || uint64_t(node.offset) >= arrays.node_count)
+                    return false;
+                depth[i] = 1 + std::max(depth[i + 1], depth[node.offset]);
+            }
+        }
+        return arrays.node_count == 0 || depth[0] <= tree_depth;
+    }
+
+    static uint64_t align_offset(uint64_t offset)
+    {
+        return (offset + cache_alignment - 1) / cache_alignment * cache_alignment;
+    }
+
+    static uint64_t element_size(int array)
+    {
+        switch (array)
+        {
+        case positions_array:
+        case normals_array:
+            return sizeof(vec3);
+        case uvs_array:
+            return sizeof(real);
+        case nodes_array:
+            return sizeof(linear_bvh_node);
+        default:
+            return sizeof(int32_t);
+        }
+    }
+
+    const point3 &vertex(int triangle, int corner) const
+    {
+        return arrays.positions[arrays.position_indices[3 * triangle + corner]];
+    }
+
+    /**
+     * @brief Möller–Trumbore算法求光线与三角形的交点
+     *
+     * @param t 交点处光线的参数
+     * @param u 交点的重心坐标（第二个顶点的权重）
+     * @param v 交点的重心坐标（第三个顶点的权重）
+     * @return 是否在ray_t范围内相交
+     */
+    bool intersect(int triangle, const ray &r, const interval &ray_t, real &t, real &u, real &v) const
+    {
+        const point3 &p0 = vertex(triangle, 0);
+        vec3 e1 = vertex(triangle, 1) - p0;
+        vec3 e2 = vertex(triangle, 2) - p0;
+
+        vec3 pvec = cross(r.direction(), e2);
+        real det = dot(e1, pvec);
+        // 光线与三角形平行或三角形退化
+        if (det == 0)
+            return false;
+        real inv_det = 1 / det;
+
+        vec3 tvec = r.origin() - p0;
+        u = dot(tvec, pvec) * inv_det;
+        if (u < 0 || u > 1)
+            return false;
+
+        vec3 qvec = cross(tvec, e1);
+        v = dot(r.direction(), qvec) * inv_det;
+        if (v < 0 || u + v > 1)
+            return false;
+
+        t = dot(e2, qvec) * inv_det;
+        return ray_t.surrounds(t);
+    }
+
+    void fill_record(int triangle, const ray &r, real t, real u, real v, hit_record &rec) const
+    {
+        real w = 1 - u - v;
+        const point3 &p0 = vertex(triangle, 0);
+
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.mat = mat.get();
+        rec.object = nullptr;
+
+        // 三个角都有法线时插值得到着色法线，否则使用几何法线（由顶点顺序决定朝向）
+        vec3 normal = cross(vertex(triangle, 1) - p0, vertex(triangle, 2) - p0);
+        if (arrays.normal_indices)
+        {
+            const int32_t *n = &arrays.normal_indices[3 * triangle];
+            if (n[0] >= 0 && n[1] >= 0 && n[2] >= 0)
+                normal = w * arrays.normals[n[0]] + u * arrays.normals[n[1]] + v * arrays.normals[n[2]];
+        }
+        rec.set_face_normal(r, unit(normal));
+
+        // 没有纹理坐标时使用重心坐标
+        rec.u = u;
+        rec.v = v;
+        if (arrays.uv_indices)
+        {
+            const int32_t *uv = &arrays.uv_indices[3 * triangle];
+            const real *uvs = arrays.uvs;
+            if (uv[0] >= 0 && uv[1] >= 0 && uv[2] >= 0)
+            {
+                rec.u = w * uvs[2 * uv[0]] + u * uvs[2 * uv[1]] + v * uvs[2 * uv[2]];
+                rec.v = w * uvs[2 * uv[0] + 1] + u * uvs[2 * uv[1] + 1] + v * uvs[2 * uv[2] + 1];
+            }
+        }
+    }
+
+    static float round_down(double x)
+    {
+        float f = static_cast<float>(x);
+        return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float round_up(double x)
+    {
+        float f = static_cast<float>(x);
+        return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static bool hit_bounds(const linear_bvh_node &node, const point3 &orig, const double inv_dir[3],
+                           const bool dir_is_neg[3], const interval &ray_t)
+    {
+        double t_min = ray_t.min, t_max = ray_t.max;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double near_plane = dir_is_neg[axis] ? node.bounds_max[axis] : node.bounds_min[axis];
+            double far_plane = dir_is_neg[axis] ? node.bounds_min[axis] : node.bounds_max[axis];
+            double t0 = (near_plane - orig[axis]) * inv_dir[axis];
+            double t1 = (far_plane - orig[axis]) * inv_dir[axis];
+            if (t0 > t_min)
+                t_min = t0;
+            if (t1 < t_max)
+                t_max = t1;
+            if (t_min > t_max)
+                return false;
+        }
+        return true;
+    }
+
+    void build()
+    {
+        size_t count = mesh.triangle_count();
+        std::vector<mesh_primitive> primitives;
+        primitives.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            int triangle = static_cast<int>(i);
+            aabb box(aabb(vertex(triangle, 0), vertex(triangle, 1)), aabb(vertex(triangle, 2), vertex(triangle, 2)));
+            point3 centroid(0.5 * (box.x.min + box.x.max), 0.5 * (box.y.min + box.y.max),
+                            0.5 * (box.z.min + box.z.max));
+            primitives.push_back({box, centroid, triangle});
+        }
+
+        bbox = aabb::empty;
+        if (count == 0)
+            return;
+
+        nodes.reserve(2 * count / max_leaf_size + 1);
+        triangles.reserve(count);
+        build_node(primitives, 0, count, 1);
+        // 平面网格的bbox厚度可能为0，与quad一样扩展到最小厚度
+        bbox = aabb(bbox.x, bbox.y, bbox.z);
+        nodes.shrink_to_fit();
+    }
+
+    // 按深度优先顺序构建节点，左孩子紧跟在父节点之后
+    void build_node(std::vector<mesh_primitive> &primitives, size_t start, size_t end, int depth)
+    {
+        tree_depth = std::max(tree_depth, depth);
+
+        aabb box = aabb::empty;
+        aabb centroid_bounds = aabb::empty;
+        for (size_t index = start; index < end; ++index)
+        {
+            box = aabb(box, primitives[index].bbox);
+            centroid_bounds = aabb(centroid_bounds, aabb(primitives[index].centroid, primitives[index].centroid));
+        }
+        if (depth == 1)
+            bbox = box;
+
+        int index = static_cast<int>(nodes.size());
+        linear_bvh_node node;
+        const interval *axes[3] = {&box.x, &box.y, &box.z};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.bounds_min[axis] = round_down(axes[axis]->min);
+            node.bounds_max[axis] = round_up(axes[axis]->max);
+        }
+        node.offset = 0;
+        node.primitive_num = 0;
+        node.axis = 0;
+        node.pad = 0;
+        nodes.push_back(node);
+
+        if (end - start <= max_leaf_size)
+        {
+            nodes[index].offset = static_cast<int32_t>(triangles.size());
+            nodes[index].primitive_num = static_cast<uint16_t>(end - start);
+            for (size_t i = start; i < end; ++i)
+                triangles.push_back(primitives[i].triangle);
+            return;
+        }
+
+        int split_axis = centroid_bounds.longest_axis();
+        size_t mid = binned_sah_split(primitives, start, end, box, centroid_bounds, split_axis);
+        nodes[index].axis = static_cast<uint8_t>(split_axis);
+
+        build_node(primitives, start, mid, depth + 1);
+        nodes[index].offset = static_cast<int32_t>(nodes.size());
+        build_node(primitives, mid, end, depth + 1);
+    }
+};
+
+#endif // !TRIANGLE_MESH_H
@@ -7,54 +7,89 @@
 #include <iostream>
 #include <ostream>
 
+#ifdef RT_SIMD_VEC3
+#include "vec3_simd.h"
+#endif
+
+// 定义RT_SIMD_VEC3时vec3按4个分量对齐存储（第4个分量为0），核心运算使用SIMD指令
 class vec3
 {
   public:
-    double e[3];
+#ifdef RT_SIMD_VEC3
+    alignas(vec3_simd::alignment) real e[4];
+
+    vec3() : e{0, 0, 0, 0}
+    {
+    }
+
+    vec3(real x, real y, real z) : e{x, y, z, 0}
+    {
+    }
+
+    explicit vec3(vec3_simd::lanes v)
+    {
+        vec3_simd::store(e, v);
+    }
+
+    vec3_simd::lanes lanes() const
+    {
+        return vec3_simd::load(e);
+    }
+#else
+    real e[3];
 
     vec3() : e{0, 0, 0}
     {
     }
 
-    vec3(double x, double y, double z) : e{x, y, z}
+    vec3(real x, real y, real z) : e{x, y, z}
     {
     }
+#endif
 
-    double x() const
+    real x() const
     {
         return e[0];
     }
 
-    double y() const
+    real y() const
     {
         return e[1];
     }
 
-    double z() const
+    real z() const
     {
         return e[2];
     }
 
     vec3 operator-() const
     {
+#ifdef RT_SIMD_VEC3
+        return vec3(vec3_simd::neg(lanes()));
+#else
         return vec3(-e[0], -e[1], -e[2]);
+#endif
     }
 
-    double operator[](int i) const
+    real operator[](int i) const
     {
         return e[i];
     }
 
-    double &operator[](int i)
+    real &operator[](int i)
     {
         return e[i];
     }
 
     vec3 &operator+=(const vec3 &v)
     {
+#ifdef RT_SIMD_VEC3
+        vec3_simd::store(e, vec3_simd::add(lanes(), v.lanes()));
+#else
         e[0] += v.e[0];
         e[1] += v.e[1];
         e[2] += v.e[2];
+#endif
 
         return *this;
     }
@@ -65,33 +100,42 @@ class vec3
         return *this += -v;
     }
 
-    vec3 &operator*=(double t)
+    vec3 &operator*=(real t)
     {
+#ifdef RT_SIMD_VEC3
+        vec3_simd::store(e, vec3_simd::mul(lanes(), vec3_simd::set1(t)));
+#else
         e[0] *= t;
         e[1] *= t;
         e[2] *= t;
+#endif
 
         return *this;
     }
 
-    vec3 &operator/=(double t)
+    vec3 &operator/=(real t)
     {
         return *this *= 1 / t;
     }
 
-    double length_squared() const
+    real length_squared() const
     {
+#ifdef RT_SIMD_VEC3
+        vec3_simd::lanes v = lanes();
+        return vec3_simd::sum3(vec3_simd::mul(v, v));
+#else
         return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+#endif
     }
 
-    double length() const
+    real length() const
     {
         return std::sqrt(length_squared());
     }
 
     bool near_zero() const
     {
-        double s = 1e-8;
+        real s = 1e-8;
         return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
 
@@ -100,7 +144,7 @@ class vec3
         return vec3(random_double(), random_double(), random_double());
     }
 
-    static vec3 random(double min, double max)
+    static vec3 random(real min, real max)
     {
         return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
     }
@@ -114,6 +158,30 @@ inline std::ostream &operator<<(std::ostream &out, const vec3 &v)
     return out << v.e[0] << " " << v.e[1] << " " << v.e[2] << std::endl;
 }
 
+#ifdef RT_SIMD_VEC3
+
+inline vec3 operator+(const vec3 &u, const vec3 &v)
+{
+    return vec3(vec3_simd::add(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator-(const vec3 &u, const vec3 &v)
+{
+    return vec3(vec3_simd::sub(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator*(const vec3 &u, const vec3 &v)
+{
+    return vec3(vec3_simd::mul(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator*(const real t, const vec3 &u)
+{
+    return vec3(vec3_simd::mul(u.lanes(), vec3_simd::set1(t)));
+}
+
+#else
+
 inline vec3 operator+(const vec3 &u, const vec3 &v)
 {
     return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
@@ -129,30 +197,43 @@ inline vec3 operator*(const vec3 &u, const vec3 &v)
     return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline vec3 operator*(const double t, const vec3 &u)
+inline vec3 operator*(const real t, const vec3 &u)
 {
     return vec3(u.e[0] * t, u.e[1] * t, u.e[2] * t);
 }
 
-inline vec3 operator*(const vec3 &u, const double t)
+#endif
+
+inline vec3 operator*(const vec3 &u, const real t)
 {
     return t * u;
 }
 
-inline vec3 operator/(const vec3 &u, double t)
+inline vec3 operator/(const vec3 &u, real t)
 {
     return (1.0 / t) * u;
 }
 
-inline double dot(const vec3 &u, const vec3 &v)
+inline real dot(const vec3 &u, const vec3 &v)
 {
+#ifdef RT_SIMD_VEC3
+    return vec3_simd::sum3(vec3_simd::mul(u.lanes(), v.lanes()));
+#else
     return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
+#endif
 }
 
 inline vec3 cross(const vec3 &u, const vec3 &v)
 {
+#ifdef RT_SIMD_VEC3
+    // u × v = (u * v.yzx - u.yzx * v).yzx
+    vec3_simd::lanes a = u.lanes(), b = v.lanes();
+    vec3_simd::lanes c = vec3_simd::sub(vec3_simd::mul(a, vec3_simd::yzx(b)), vec3_simd::mul(vec3_simd::yzx(a), b));
+    return vec3(vec3_simd::yzx(c));
+#else
     return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1], u.e[2] * v.e[0] - u.e[0] * v.e[2],
                 u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+#endif
 }
 
 inline vec3 unit(const vec3 &u)
@@ -162,10 +243,21 @@ inline vec3 unit(const vec3 &u)
 
 inline vec3 random_unit_vector()
 {
+    // 低差异序列的每个采样需要消耗固定数量的维度，使用二维采样到球面的映射代替拒绝采样
+    if (sobol_sample_active())
+    {
+        double u1, u2;
+        random_double_2d(u1, u2);
+        real z = real(1 - 2 * u1);
+        real r = std::sqrt(std::fmax(real(0), 1 - z * z));
+        real phi = real(2 * pi * u2);
+        return vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
     while (true)
     {
         point3 p = vec3::random(-1, 1);
-        double lensp = p.length_squared();
+        real lensp = p.length_squared();
 
         // 防止len过小，导致向量趋近于正无穷
         // len <= 1可以去掉吗？ 不可以
@@ -192,6 +284,28 @@ inline vec3 random_on_hemisphere(const vec3 &normal)
 
 inline vec3 random_in_unit_disk()
 {
+    // 同心圆映射（Shirley-Chiu）将正方形映射到圆盘，保持二维采样的分层
+    if (sobol_sample_active())
+    {
+        double u1, u2;
+        random_double_2d(u1, u2);
+        real a = real(2 * u1 - 1), b = real(2 * u2 - 1);
+        if (a == 0 && b == 0)
+            return point3(0, 0, 0);
+        real r, theta;
+        if (std::fabs(a) > std::fabs(b))
+        {
+            r = a;
+            theta = real(pi / 4) * (b / a);
+        }
+        else
+        {
+            r = b;
+            theta = real(pi / 2) - real(pi / 4) * (a / b);
+        }
+        return point3(r * std::cos(theta), r * std::sin(theta), 0);
+    }
+
     while (true)
     {
         point3 p = point3(random_double(-1, 1), random_double(-1, 1), 0);
@@ -220,9 +334,9 @@ inline vec3 reflect(const vec3 &in_dir, const vec3 &out_normal)
  * @param etai_over_etat snell's law中theta / theta'的值
  * @return 折射方向（单位向量）
  */
-inline vec3 refract(const vec3 &in_dir, const vec3 &normal, double etai_over_etat)
+inline vec3 refract(const vec3 &in_dir, const vec3 &normal, real etai_over_etat)
 {
-    double cos_theta = std::fmin(1.0, dot(-in_dir, normal));
+    real cos_theta = std::fmin(1.0, dot(-in_dir, normal));
     vec3 out_dir_prep = etai_over_etat * (in_dir + cos_theta * normal);
     // 代码中sqrt内部加了fabs，个人觉得不需要，加上了代码不会崩溃，但是如果长度大于1，说明输入存在问题
     vec3 out_dir_parallel = -std::sqrt(1 - out_dir_prep.length_squared()) * normal;
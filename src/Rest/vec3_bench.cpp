@@ -0,0 +1,123 @@
+// vec3核心运算的微基准测试
+// 同一份代码分别编译为标量版本（vec3_bench）和定义了RT_SIMD_VEC3的4分量对齐版本（vec3_bench_simd），比较两者的耗时
+
+#include "global.h"
+#include "vec3.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// 防止编译器将结果未被使用的计算优化掉
+volatile real sink;
+
+/**
+ * @brief 重复执行op并输出每次运算的平均耗时
+ *
+ * @param name 运算名称
+ * @param count 每一轮的运算次数
+ * @param rounds 轮数
+ * @param op 执行一轮运算，返回一个依赖所有结果的值
+ */
+template <class F> void run(const std::string &name, size_t count, int rounds, F op)
+{
+    // 预热
+    sink = op();
+
+    auto start = std::chrono::steady_clock::now();
+    real result = 0;
+    for (int r = 0; r < rounds; ++r)
+        result += op();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sink = result;
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << seconds * 1e9 / (double(count) * rounds) << " ns/op" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // 参数：每轮向量个数、轮数
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    seed_random(1);
+    std::vector<vec3> a(count), b(count), out(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        a[i] = vec3::random(-1, 1);
+        b[i] = vec3::random(-1, 1);
+    }
+
+#ifdef RT_SIMD_VEC3
+    std::cout << "vec3: simd, " << sizeof(vec3) << " bytes" << std::endl;
+#else
+    std::cout << "vec3: scalar, " << sizeof(vec3) << " bytes" << std::endl;
+#endif
+    std::cout << "real: " << (sizeof(real) == sizeof(float) ? "float" : "double") << ", " << count << " vectors x "
+              << rounds << " rounds" << std::endl;
+
+    run("add", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = a[i] + b[i];
+        return out[count / 2].x();
+    });
+
+    run("mul", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = a[i] * b[i];
+        return out[count / 2].x();
+    });
+
+    run("scale", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = 0.5 * a[i];
+        return out[count / 2].x();
+    });
+
+    run("dot", count, rounds, [&]() {
+        real sum = 0;
+        for (size_t i = 0; i < count; ++i)
+            sum += dot(a[i], b[i]);
+        return sum;
+    });
+
+    run("cross", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = cross(a[i], b[i]);
+        return out[count / 2].x();
+    });
+
+    run("unit", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = unit(a[i]);
+        return out[count / 2].x();
+    });
+
+    // 与路径追踪中的吞吐量更新、反射方向计算类似的组合运算
+    run("reflect", count, rounds, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = reflect(a[i], unit(b[i]));
+        return out[count / 2].x();
+    });
+
+    run("throughput", count, rounds, [&]() {
+        vec3 throughput(1, 1, 1);
+        vec3 radiance;
+        for (size_t i = 0; i < count; ++i)
+        {
+            radiance += throughput * a[i];
+            throughput = throughput * b[i];
+        }
+        return radiance.x() + throughput.y();
+    });
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+#ifndef VEC3_SIMD_H
+#define VEC3_SIMD_H
+
+#include "global.h"
+#include <immintrin.h>
+
+// vec3按4个分量对齐存储时使用的向量运算，第4个分量始终为0
+// double使用AVX（256位），float使用SSE（128位），都不支持时退化为逐分量的循环
+namespace vec3_simd
+{
+
+constexpr size_t alignment = 4 * sizeof(real);
+
+#if defined(__AVX__) && !defined(RT_USE_FLOAT)
+
+using lanes = __m256d;
+
+inline lanes load(const real *p)
+{
+    return _mm256_load_pd(p);
+}
+
+inline void store(real *p, lanes a)
+{
+    _mm256_store_pd(p, a);
+}
+
+inline lanes set1(real t)
+{
+    return _mm256_set1_pd(t);
+}
+
+inline lanes add(lanes a, lanes b)
+{
+    return _mm256_add_pd(a, b);
+}
+
+inline lanes sub(lanes a, lanes b)
+{
+    return _mm256_sub_pd(a, b);
+}
+
+inline lanes mul(lanes a, lanes b)
+{
+    return _mm256_mul_pd(a, b);
+}
+
+inline lanes neg(lanes a)
+{
+    return _mm256_xor_pd(a, _mm256_set1_pd(-0.0));
+}
+
+// (x, y, z, w) -> (y, z, x, w)
+inline lanes yzx(lanes a)
+{
+#ifdef __AVX2__
+    return _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1));
+#else
+    alignas(alignment) real t[4];
+    _mm256_store_pd(t, a);
+    return _mm256_set_pd(t[3], t[0], t[2], t[1]);
+#endif
+}
+
+// 前三个分量之和，求和顺序与标量版本相同：(x + y) + z
+inline real sum3(lanes a)
+{
+    __m128d xy = _mm256_castpd256_pd128(a);
+    __m128d zw = _mm256_extractf128_pd(a, 1);
+    __m128d sum = _mm_add_sd(xy, _mm_unpackhi_pd(xy, xy));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, zw));
+}
+
+#elif defined(__SSE__) && defined(RT_USE_FLOAT)
+
+using lanes = __m128;
+
+inline lanes load(const real *p)
+{
+    return _mm_load_ps(p);
+}
+
+inline void store(real *p, lanes a)
+{
+    _mm_store_ps(p, a);
+}
+
+inline lanes set1(real t)
+{
+    return _mm_set1_ps(t);
+}
+
+inline lanes add(lanes a, lanes b)
+{
+    return _mm_add_ps(a, b);
+}
+
+inline lanes sub(lanes a, lanes b)
+{
+    return _mm_sub_ps(a, b);
+}
+
+inline lanes mul(lanes a, lanes b)
+{
+    return _mm_mul_ps(a, b);
+}
+
+inline lanes neg(lanes a)
+{
+    return _mm_xor_ps(a, _mm_set1_ps(-0.0f));
+}
+
+inline lanes yzx(lanes a)
+{
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+inline real sum3(lanes a)
+{
+    __m128 y = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_movehl_ps(a, a);
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(a, y), z));
+}
+
+#else
+
+struct lanes
+{
+    real v[4];
+};
+
+inline lanes load(const real *p)
+{
+    return {{p[0], p[1], p[2], p[3]}};
+}
+
+inline void store(real *p, lanes a)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = a.v[i];
+}
+
+inline lanes set1(real t)
+{
+    return {{t, t, t, t}};
+}
+
+inline lanes add(lanes a, lanes b)
+{
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+
+inline lanes sub(lanes a, lanes b)
+{
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+
+inline lanes mul(lanes a, lanes b)
+{
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+
+inline lanes neg(lanes a)
+{
+    return {{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}};
+}
+
+inline lanes yzx(lanes a)
+{
+    return {{a.v[1], a.v[2], a.v[0], a.v[3]}};
+}
+
+inline real sum3(lanes a)
+{
+    return a.v[0] + a.v[1] + a.v[2];
+}
+
+#endif
+
+} // namespace vec3_simd
+
+#endif // !VEC3_SIMD_H